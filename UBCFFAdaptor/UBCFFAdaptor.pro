@@ -33,13 +33,25 @@ DEFINES += UBCFFADAPTOR_LIBRARY
 DEFINES += NO_THIRD_PARTY_WARNINGS
 
 SOURCES += \
-    src/UBCFFAdaptor.cpp
+    src/UBCFFAdaptor.cpp \
+    src/UBCFFPageCache.cpp \
+    src/UBCFFDocumentCache.cpp \
+    src/UBCFFConversionJob.cpp \
+    src/UBCFFNumericCodec.cpp \
+    src/UBCFFTmpReaper.cpp \
+    src/UBCFFOutputManifest.cpp
 
 HEADERS +=\
     src/UBCFFAdaptor.h \
     src/UBCFFAdaptor_global.h \
     src/UBGlobals.h \
-    src/UBCFFConstants.h
+    src/UBCFFConstants.h \
+    src/UBCFFPageCache.h \
+    src/UBCFFDocumentCache.h \
+    src/UBCFFConversionJob.h \
+    src/UBCFFNumericCodec.h \
+    src/UBCFFTmpReaper.h \
+    src/UBCFFOutputManifest.h
 
 RESOURCES += \
     ../resources/resources.qrc
@@ -9,6 +9,12 @@
 
 #include "UBGlobals.h"
 #include "UBCFFConstants.h"
+#include "UBCFFPageCache.h"
+#include "UBCFFDocumentCache.h"
+#include "UBCFFConversionJob.h"
+#include "UBCFFNumericCodec.h"
+#include "UBCFFTmpReaper.h"
+#include "UBCFFOutputManifest.h"
 
 THIRD_PARTY_WARNINGS_DISABLE
 #include "quazip.h"
@@ -17,45 +23,218 @@ THIRD_PARTY_WARNINGS_DISABLE
 THIRD_PARTY_WARNINGS_ENABLE
 
 UBCFFAdaptor::UBCFFAdaptor()
+    : mTmpRoot(QDir::tempPath())
+    , mCompactOutput(false)
+    , mIncremental(false)
+    , mOptimizeStrokes(false)
+    , mStrokeTolerance(0.5)
+    , mDocumentCacheSize(DEFAULT_DOCUMENT_CACHE_SIZE)
+    , mJob(NULL)
 {}
 
 bool UBCFFAdaptor::convertUBZToIWB(const QString &from, const QString &to)
 {
     qDebug() << "starting converion from" << from << "to" << to;
 
+    return convert(from, NULL, to, NULL);
+}
+
+bool UBCFFAdaptor::convertUBZToIWB(const QString &from, QIODevice *to)
+{
+    qDebug() << "starting converion from" << from << "to a device";
+
+    if (!to) {
+        qDebug() << "no output device, stopping conversion";
+        return false;
+    }
+
+    return convert(from, NULL, QString(), to);
+}
+
+bool UBCFFAdaptor::convertUBZToIWB(QIODevice *from, QIODevice *to)
+{
+    qDebug() << "starting converion from a device to a device";
+
+    if (!from || !to) {
+        qDebug() << "no input or output device, stopping conversion";
+        return false;
+    }
+
+    //the archive is read at random, a sequential input is taken in memory first
+    QBuffer fromBuffer;
+    if (from->isSequential()) {
+        if (!from->isOpen() && !from->open(QIODevice::ReadOnly)) {
+            qDebug() << "can't open the input device, stopping conversion";
+            return false;
+        }
+        fromBuffer.setData(from->readAll());
+        from = &fromBuffer;
+    }
+
+    return convert(QString(), from, QString(), to);
+}
+
+bool UBCFFAdaptor::convertUBZToIWB(const QByteArray &from, QByteArray *to)
+{
+    if (!to)
+        return false;
+
+    QBuffer fromBuffer;
+    fromBuffer.setData(from);
+    to->clear();
+    QBuffer toBuffer(to);
+
+    return convertUBZToIWB(&fromBuffer, &toBuffer);
+}
+
+// Reads the ubz from the "from" file or folder, or from "fromDevice" if it is set.
+// Writes the iwb to the "to" file, or to "toDevice" if it is set
+bool UBCFFAdaptor::convert(const QString &from, QIODevice *fromDevice, const QString &to, QIODevice *toDevice)
+{
+    mProfile = UBCFFConversionProfile();
+    QElapsedTimer phaseTimer;
+
+    UBCFFDocumentCache documentCache(mDocumentCacheDir, mDocumentCacheSize);
+    QString documentKey;
+    if (!mDocumentCacheDir.isEmpty() && (fromDevice || QFileInfo(from).isFile())) {
+        documentKey = fromDevice ? documentCache.documentKey(fromDevice, documentCacheOptions())
+                                 : documentCache.documentKey(from, documentCacheOptions());
+        bool written = false;
+        if (toDevice ? documentCache.fetch(documentKey, toDevice, &written) : documentCache.fetch(documentKey, to)) {
+            qDebug() << "the same document was converted before, took it from the cache";
+            return true;
+        }
+        //another archive after a part of the cached one would corrupt the output
+        if (written) {
+            qDebug() << "the cached document was written to the device only partially, stopping conversion";
+            return false;
+        }
+    }
+
+    if (isCanceled())
+        return false;
+
     QString source = QString();
-    if (QFileInfo(from).isDir() && QFile::exists(from)) {
+    QStringList pageFileNames;
+    if (!fromDevice && QFileInfo(from).isDir() && QFile::exists(from)) {
         qDebug() << "File specified is dir, continuing convertion";
         source = from;
     } else {
-        source = uncompressZip(from);
+        phaseTimer.start();
+        source = uncompressZip(from, fromDevice, &pageFileNames);
+        mProfile.unzipTime = phaseTimer.nsecsElapsed();
         if (!source.isNull()) qDebug() << "File specified is zip file. Uncompressed to tmp dir, continuing convertion";
     }
     if (source.isNull()) {
         qDebug() << "File specified is not a dir or a zip file, stopping covretion";
+        freeTmpDirs();
         return false;
     }
 
     QString tmpDestination = createNewTmpDir();
     if (tmpDestination.isNull()) {
         qDebug() << "can't create temp destination folder. Stopping parsing...";
+        freeTmpDirs();
         return false;
     }
 
     UBToCFFConverter tmpConvertrer(source, tmpDestination);
+    tmpConvertrer.setCompactOutput(mCompactOutput);
+    tmpConvertrer.setStrokeOptimization(mOptimizeStrokes, mStrokeTolerance);
+    tmpConvertrer.setPrecisionPolicy(mPrecisionPolicy);
+    tmpConvertrer.setPageFileNames(pageFileNames);
+    tmpConvertrer.setJob(mJob);
     if (!tmpConvertrer) {
         qDebug() << "The convertrer class is invalid, stopping conversion. Error message" << tmpConvertrer.lastErrStr();
+        freeTmpDirs();
+        return false;
+    }
+
+    //unchanged pages and their media are taken from the cache of the previous run,
+    //the previous output is kept aside to copy the already compressed media from it.
+    //There is no previous output for a device
+    bool incremental = mIncremental && !toDevice;
+    UBCFFPageCache pageCache(QFileInfo(to).absoluteFilePath() + sPageCacheDirSuffix);
+    if (incremental) {
+        pageCache.load();
+        QFile::remove(pageCache.previousArchive());
+        if (QFile::exists(to) && QDir().mkpath(pageCache.cacheDir()))
+            QFile::rename(to, pageCache.previousArchive());
+        tmpConvertrer.setPageCache(&pageCache);
+    }
+
+    //content.xml is deflated straight into the archive while it is generated,
+    //media files the converter puts to tmpDestination are packed after it.
+    //The old file is removed, not truncated.
+    //A device is written sequentially, so it may be a pipe, a socket or stdout
+    if (!toDevice)
+        QFile::remove(to);
+    QuaZip zip(to);
+    zip.setIoDevice(toDevice);
+    if (!createZip(&zip)) {
+        if (incremental)
+            QFile::rename(pageCache.previousArchive(), to);
+        freeTmpDirs();
+        return false;
+    }
+
+    QuaZipFile contentZipFile(&zip);
+    if (!contentZipFile.open(QIODevice::WriteOnly, QuaZipNewInfo(fIWBContent))) {
+        qDebug() << "Compression of" << fIWBContent << "failed. Cause: outFile.open(): " << contentZipFile.getZipError();
+        zip.close();
+        QFile::remove(to);
+        if (incremental)
+            QFile::rename(pageCache.previousArchive(), to);
+        freeTmpDirs();
         return false;
     }
-    if (!tmpConvertrer.parse()) {
+
+    phaseTimer.start();
+    bool parsed = tmpConvertrer.parse(&contentZipFile);
+    mProfile.contentSize = contentZipFile.pos();
+    contentZipFile.close();
+    mProfile.rasterizeTime = tmpConvertrer.rasterizeTime();
+    mProfile.parseTime = phaseTimer.nsecsElapsed() - mProfile.rasterizeTime;
+    if (!parsed || contentZipFile.getZipError() != ZIP_OK) {
+        zip.close();
+        QFile::remove(to);
+        if (incremental)
+            QFile::rename(pageCache.previousArchive(), to);
+        freeTmpDirs();
         return false;
     }
 
-    if (!compressZip(tmpDestination, to))
+    phaseTimer.start();
+    bool compressed = compressZip(tmpConvertrer.outputManifest(), &zip);
+    if (!compressed)
         qDebug() << "error in compression";
 
+    if (incremental && !compressReusedFiles(tmpConvertrer.reusedMediaFiles(), &pageCache, &zip)) {
+        qDebug() << "error in compression of unchanged media files";
+        compressed = false;
+    }
+    zip.close();
+    mProfile.packTime = phaseTimer.nsecsElapsed();
+
+    //the cache and the previous output are only replaced by a complete archive
+    if (!compressed || zip.getZipError() != ZIP_OK || isCanceled()) {
+        QFile::remove(to);
+        if (incremental)
+            QFile::rename(pageCache.previousArchive(), to);
+        freeTmpDirs();
+        return false;
+    }
+
+    if (incremental) {
+        pageCache.save();
+        QFile::remove(pageCache.previousArchive());
+    }
+
+    if (!documentKey.isEmpty() && !toDevice)
+        documentCache.store(documentKey, to);
+
     //Cleanning tmp souces in filesystem
-    if (!QFileInfo(from).isDir())
+    if (fromDevice || !QFileInfo(from).isDir())
     if (!freeDir(source))
         qDebug() << "can't delete tmp directory" << QDir(source).absolutePath() << "try to delete them manually";
 
@@ -65,9 +244,25 @@ bool UBCFFAdaptor::convertUBZToIWB(const QString &from, const QString &to)
     return true;
 }
 
-QString UBCFFAdaptor::uncompressZip(const QString &zipFile)
+void UBCFFAdaptor::setDocumentCache(const QString &cacheDir, qint64 maxSize)
+{
+    mDocumentCacheDir = cacheDir;
+    mDocumentCacheSize = maxSize;
+}
+
+// Everything besides the source ubz the resulting iwb depends on
+QString UBCFFAdaptor::documentCacheOptions() const
+{
+    return QString("compact=%1 strokes=%2,%3 precision=%4").arg(mCompactOutput ? avTrue : avFalse)
+                                                           .arg(mOptimizeStrokes ? avTrue : avFalse)
+                                                           .arg(mStrokeTolerance)
+                                                           .arg(mPrecisionPolicy.key());
+}
+
+QString UBCFFAdaptor::uncompressZip(const QString &zipFile, QIODevice *zipDevice, QStringList *pageFileNames)
 {
     QuaZip zip(zipFile);
+    zip.setIoDevice(zipDevice);
 
     if(!zip.open(QuaZip::mdUnzip)) {
         qWarning() << "Import failed. Cause zip.open(): " << zip.getZipError();
@@ -75,7 +270,11 @@ QString UBCFFAdaptor::uncompressZip(const QString &zipFile)
     }
 
     zip.setFileNameCodec("UTF-8");
-    QuaZipFileInfo info;
+    if (!zip.loadDirectory()) {
+        qWarning() << "Import failed. Cause: loadDirectory(): " << zip.getZipError();
+        zip.close();
+        return QString();
+    }
     QuaZipFile file(&zip);
 
     //create unique cff document root fodler
@@ -90,9 +289,13 @@ QString UBCFFAdaptor::uncompressZip(const QString &zipFile)
     QFile out;
     char c;
     bool allOk = true;
-    for(bool more = zip.goToFirstFile(); more; more=zip.goToNextFile()) {
-        if(!zip.getCurrentFileInfo(&info)) {
-            qWarning() << "Import failed. Cause: getCurrentFileInfo(): " << zip.getZipError();
+    foreach (const QuaZipDirEntry &entry, zip.getDirectory()) {
+        if (isCanceled()) {
+            allOk = false;
+            break;
+        }
+        if(!zip.goToEntry(entry)) {
+            qWarning() << "Import failed. Cause: goToEntry(): " << zip.getZipError();
             allOk = false;
             break;
         }
@@ -106,7 +309,11 @@ QString UBCFFAdaptor::uncompressZip(const QString &zipFile)
             break;
         }
 
-        QString newFileName = documentRootFolder + "/" + file.getActualFileName();
+        QString actualFileName = entry.name;
+        QString newFileName = documentRootFolder + "/" + actualFileName;
+        if (pageFileNames && !actualFileName.contains('/')
+                && actualFileName.startsWith(pageAlias) && actualFileName.endsWith("." + pageFileExtentionUBZ))
+            pageFileNames->append(actualFileName);
 
         QFileInfo newFileInfo(newFileName);
         rootDir.mkpath(newFileInfo.absolutePath());
@@ -153,59 +360,92 @@ QString UBCFFAdaptor::uncompressZip(const QString &zipFile)
     return documentRootFolder;
 }
 
-bool UBCFFAdaptor::compressZip(const QString &source, const QString &destination)
+bool UBCFFAdaptor::createZip(QuaZip *zip)
 {
-    QDir toDir = QFileInfo(destination).dir();
-    if (!toDir.exists())
+    QDir toDir = QFileInfo(zip->getZipName()).dir();
+    if (!zip->getIoDevice() && !toDir.exists())
         if (!QDir().mkpath(toDir.absolutePath())) {
             qDebug() << "can't create destination folder to uncompress file";
             return false;
         }
 
-    QuaZip zip(destination);
-    zip.setFileNameCodec("UTF-8");
-    if(!zip.open(QuaZip::mdCreate)) {
-        qDebug("Export failed. Cause: zip.open(): %d", zip.getZipError());
+    zip->setFileNameCodec("UTF-8");
+    if(!zip->open(QuaZip::mdCreate)) {
+        qDebug("Export failed. Cause: zip.open(): %d", zip->getZipError());
         return false;
     }
 
-    QuaZipFile outZip(&zip);
+    return true;
+}
+
+// Files written by the converter are packed in the order they were written, without walking
+// the destination folder. Media compressed already are stored with the crc computed when they
+// were written. Streaming readers can't find the end of a stored entry followed by a data
+// descriptor, a sequential output gets them deflated without compression instead
+bool UBCFFAdaptor::compressZip(const UBCFFOutputManifest *manifest, QuaZip *zip)
+{
+    QuaZipFile outZip(zip);
+    bool sequential = zip->getIoDevice() && zip->getIoDevice()->isSequential();
 
-    QFileInfo sourceInfo(source);
-    if (sourceInfo.isDir()) {
-        if (!compressDir(QFileInfo(source).absoluteFilePath(), "", &outZip))
+    foreach (const UBCFFOutputManifest::Entry &entry, manifest->entries()) {
+        if (isCanceled())
             return false;
-    } else if (sourceInfo.isFile()) {
-        if (!compressFile(QFileInfo(source).absoluteFilePath(), "", &outZip))
+
+        QString fileName = manifest->filePath(entry.path);
+        bool compressed;
+        if (UBCFFOutputManifest::Store == entry.compression && !sequential)
+            compressed = storeFile(fileName, entry, &outZip);
+        else
+            compressed = compressFile(fileName, entry.path.left(entry.path.lastIndexOf("/") + 1), &outZip,
+                                      UBCFFOutputManifest::Store == entry.compression ? Z_NO_COMPRESSION : Z_DEFAULT_COMPRESSION);
+        if (!compressed)
             return false;
     }
 
     return true;
 }
 
-bool UBCFFAdaptor::compressDir(const QString &dirName, const QString &parentDir, QuaZipFile *outZip)
+bool UBCFFAdaptor::storeFile(const QString &fileName, const UBCFFOutputManifest::Entry &entry, QuaZipFile *outZip)
 {
-    QFileInfoList dirFiles = QDir(dirName).entryInfoList(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
-    QListIterator<QFileInfo> iter(dirFiles);
-    while (iter.hasNext()) {
-        QFileInfo curFile = iter.next();
+    QFile sourceFile(fileName);
 
-        if (curFile.isDir()) {
-            if (!compressDir(curFile.absoluteFilePath(), parentDir + curFile.fileName() + "/", outZip)) {
-                qDebug() << "error at compressing dir" << curFile.absoluteFilePath();
-                return false;
-            }
-        } else if (curFile.isFile()) {
-            if (!compressFile(curFile.absoluteFilePath(), parentDir, outZip)) {
-               return false;
-            }
-        }
+    if(!sourceFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: inFile.open(): " << sourceFile.errorString();
+        return false;
+    }
+
+    QuaZipNewInfo newInfo(entry.path, sourceFile.fileName());
+    newInfo.uncompressedSize = (quint64)entry.size;
+    if(!outZip->open(QIODevice::WriteOnly, newInfo, NULL, entry.crc, 0, Z_NO_COMPRESSION, true)) {
+        qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.open(): " << outZip->getZipError();
+        return false;
+    }
+
+    qint64 bytesStored = 0;
+    while (!sourceFile.atEnd()) {
+        QByteArray chunk = sourceFile.read(iZipCopyChunkSize);
+        if (chunk.isEmpty() || outZip->write(chunk) != chunk.size())
+            break;
+        bytesStored += chunk.size();
+        reportBytes(chunk.size());
+    }
+    // the crc is of the file as the converter wrote it
+    if (bytesStored != entry.size || !sourceFile.atEnd()) {
+        qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.write(): " << outZip->getZipError();
+        outZip->close();
+        return false;
+    }
+
+    outZip->close();
+    if (outZip->getZipError() != ZIP_OK) {
+        qWarning() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.close(): " << outZip->getZipError();
+        return false;
     }
 
     return true;
 }
 
-bool UBCFFAdaptor::compressFile(const QString &fileName, const QString &parentDir, QuaZipFile *outZip)
+bool UBCFFAdaptor::compressFile(const QString &fileName, const QString &parentDir, QuaZipFile *outZip, int level)
 {
     QFile sourceFile(fileName);
 
@@ -214,14 +454,27 @@ bool UBCFFAdaptor::compressFile(const QString &fileName, const QString &parentDi
         return false;
     }
 
-    if(!outZip->open(QIODevice::WriteOnly, QuaZipNewInfo(parentDir + QFileInfo(fileName).fileName(), sourceFile.fileName()))) {
+    QuaZipNewInfo newInfo(parentDir + QFileInfo(fileName).fileName(), sourceFile.fileName());
+    newInfo.uncompressedSize = sourceFile.size(); // files over 4 GB are written as ZIP64
+    if (Z_DEFAULT_COMPRESSION == level && sourceFile.size() >= iParallelDeflateThreshold && QThread::idealThreadCount() > 1) {
+        bool result = compressFileParallel(sourceFile, newInfo, outZip);
+        sourceFile.close();
+        return result;
+    }
+
+    if(!outZip->open(QIODevice::WriteOnly, newInfo, NULL, 0, Z_DEFLATED, level)) {
         qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.open(): " << outZip->getZipError();
         sourceFile.close();
         return false;
     }
 
-    outZip->write(sourceFile.readAll());
-    if(outZip->getZipError() != UNZ_OK) {
+    while (!sourceFile.atEnd() && outZip->getZipError() == UNZ_OK) {
+        QByteArray chunk = sourceFile.read(iZipCopyChunkSize);
+        if (chunk.isEmpty())
+            break;
+        outZip->write(chunk);
+    }
+    if(outZip->getZipError() != UNZ_OK || !sourceFile.atEnd()) {
         qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.write(): " << outZip->getZipError();
 
         sourceFile.close();
@@ -239,75 +492,258 @@ bool UBCFFAdaptor::compressFile(const QString &fileName, const QString &parentDi
     }
 
     outZip->close();
+    reportBytes(sourceFile.size());
     sourceFile.close();
 
     return true;
 }
 
-QString UBCFFAdaptor::createNewTmpDir()
+// One block of a file deflated in parallel. Every block is a raw deflate
+// stream primed with the tail of the previous block and ended by a sync flush
+// (the last one by Z_FINISH), so the blocks concatenate into a single stream.
+struct UBDeflateBlock
+{
+    QByteArray data;
+    QByteArray dictionary;
+    bool last;
+    QByteArray deflated;
+    uLong crc;
+    bool ok;
+};
+
+static void deflateBlock(UBDeflateBlock &block)
 {
-    int tmpNumber = 0;
-    QDir systemTmp = QDir::temp();
-
-    while (true) {
-        QString dirName = QString("CFF_adaptor_filedata_store%1.%2")
-                .arg(QDateTime::currentDateTime().toString("dd_MM_yyyy_HH-mm"))
-                .arg(tmpNumber++);
-        if (!systemTmp.exists(dirName)) {
-            if (systemTmp.mkdir(dirName)) {
-                QString result = systemTmp.absolutePath() + "/" + dirName;
-                tmpDirs.append(result);
-                return result;
-            } else {
-                qDebug() << "Can't create temporary dir maybe due to permissions";
-                return QString();
+    block.ok = false;
+    block.crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)block.data.constData(), block.data.size());
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    if (!block.dictionary.isEmpty())
+        deflateSetDictionary(&stream, (const Bytef*)block.dictionary.constData(), block.dictionary.size());
+
+    // sync flush marker and stored block headers are not counted by deflateBound()
+    block.deflated.resize(deflateBound(&stream, block.data.size()) + 64);
+    stream.next_in = (Bytef*)block.data.data();
+    stream.avail_in = block.data.size();
+    stream.next_out = (Bytef*)block.deflated.data();
+    stream.avail_out = block.deflated.size();
+
+    int err = deflate(&stream, block.last ? Z_FINISH : Z_SYNC_FLUSH);
+    block.ok = block.last ? (err == Z_STREAM_END) : (err == Z_OK && stream.avail_in == 0 && stream.avail_out != 0);
+    block.deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+}
+
+bool UBCFFAdaptor::compressFileParallel(QFile &sourceFile, const QuaZipNewInfo &info, QuaZipFile *outZip)
+{
+    qint64 fileSize = sourceFile.size();
+
+    QuaZipNewInfo rawInfo(info);
+    rawInfo.uncompressedSize = (quint64)fileSize;
+    if(!outZip->open(QIODevice::WriteOnly, rawInfo, NULL, 0, Z_DEFLATED, Z_DEFAULT_COMPRESSION, true)) {
+        qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.open(): " << outZip->getZipError();
+        return false;
+    }
+
+    // reading a couple of blocks per thread at a time keeps the memory bounded for huge files
+    int blocksPerBatch = 2*QThread::idealThreadCount();
+    uLong crc = crc32(0L, Z_NULL, 0);
+    QByteArray dictionary;
+    qint64 bytesRead = 0;
+
+    while (bytesRead < fileSize) {
+        if (isCanceled()) {
+            outZip->close();
+            return false;
+        }
+
+        QList<UBDeflateBlock> batch;
+        for (int i = 0; i < blocksPerBatch && bytesRead < fileSize; i++) {
+            UBDeflateBlock block;
+            block.data = sourceFile.read(iParallelDeflateBlockSize);
+            if (block.data.isEmpty()) {
+                qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: inFile.read(): " << sourceFile.errorString();
+                outZip->close();
+                return false;
             }
-        } else if (tmpNumber == 10) {
-            qWarning() << "Import failed. Failed to create temporary file ";
-            return QString();
+            bytesRead += block.data.size();
+            block.dictionary = dictionary;
+            block.last = (bytesRead >= fileSize);
+            dictionary = block.data.right(iDeflateDictionarySize);
+            batch.append(block);
+        }
+
+        QtConcurrent::blockingMap(batch, deflateBlock);
+
+        foreach (const UBDeflateBlock &block, batch) {
+            if (!block.ok) {
+                qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: deflate()";
+                outZip->close();
+                return false;
+            }
+            crc = crc32_combine(crc, block.crc, block.data.size());
+            if (outZip->write(block.deflated) != block.deflated.size()) {
+                qDebug() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.write(): " << outZip->getZipError();
+                outZip->close();
+                return false;
+            }
+            reportBytes(block.data.size());
         }
-        tmpNumber++;
     }
 
-    return QString();
+    outZip->setRawFileInfo((quint32)crc, (quint64)fileSize);
+    outZip->close();
+    if (outZip->getZipError() != ZIP_OK) {
+        qWarning() << "Compression of file" << sourceFile.fileName() << " failed. Cause: outFile.close(): " << outZip->getZipError();
+        return false;
+    }
+
+    return true;
 }
-bool UBCFFAdaptor::deleteDir(const QString& pDirPath) const
+
+// Media of unchanged pages are copied compressed from the previous output,
+// the cached copy is compressed again only if the previous output lacks them
+bool UBCFFAdaptor::compressReusedFiles(const QStringList &files, UBCFFPageCache *pageCache, QuaZip *zip)
+{
+    QStringList reusedFiles = files;
+    reusedFiles.removeDuplicates();
+    if (reusedFiles.isEmpty())
+        return true;
+
+    QuaZip previousZip(pageCache->previousArchive());
+    previousZip.setFileNameCodec("UTF-8");
+    bool hasPreviousZip = QFile::exists(pageCache->previousArchive()) && previousZip.open(QuaZip::mdUnzip)
+                          && previousZip.loadDirectory();
+
+    QuaZipFile outZip(zip);
+    foreach (QString reusedFile, reusedFiles) {
+        if (isCanceled())
+            return false;
+        bool entryStarted = false;
+        if (hasPreviousZip && copyZipEntry(&previousZip, reusedFile, &outZip, &entryStarted))
+            continue;
+        if (entryStarted) // a broken entry is in the output already, it can't be redone
+            return false;
+        int level = UBCFFOutputManifest::Store == UBCFFOutputManifest::compressionFor(reusedFile) ? Z_NO_COMPRESSION : Z_DEFAULT_COMPRESSION;
+        if (!compressFile(pageCache->mediaFilePath(reusedFile), QFileInfo(reusedFile).path() + "/", &outZip, level))
+            return false;
+    }
+
+    return true;
+}
+
+static QDateTime dateTimeFromDosDate(quint32 dosDate)
 {
-    if (pDirPath == "" || pDirPath == "." || pDirPath == "..")
+    quint32 date = dosDate >> 16;
+    return QDateTime(QDate(((date & 0xFE00) >> 9) + 1980, (date & 0x1E0) >> 5, date & 0x1F),
+                     QTime((dosDate & 0xF800) >> 11, (dosDate & 0x7E0) >> 5, 2 * (dosDate & 0x1F)));
+}
+
+bool UBCFFAdaptor::copyZipEntry(QuaZip *fromZip, const QString &entryName, QuaZipFile *outZip, bool *entryStarted)
+{
+    int index = fromZip->hasDirectory() ? fromZip->findEntry(entryName) : -1;
+    if (-1 == index)
+        return false;
+    const QuaZipDirEntry entry = fromZip->getDirectory().at(index);
+    if (!fromZip->goToEntry(entry))
         return false;
 
-    QDir dir(pDirPath);
+    int method = 0;
+    int level = 0;
+    QuaZipFile inFile(fromZip);
+    if (!inFile.open(QIODevice::ReadOnly, &method, &level, true))
+        return false;
 
-    if (dir.exists())
-    {
-        foreach(QFileInfo dirContent, dir.entryInfoList(QDir::Files | QDir::Dirs
-                | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDir::Name))
-        {
-            if (dirContent.isDir())
-            {
-                deleteDir(dirContent.absoluteFilePath());
-            }
-            else
-            {
-                if (!dirContent.dir().remove(dirContent.fileName()))
-                {
-                    return false;
-                }
-            }
+    QuaZipNewInfo newInfo(entryName);
+    newInfo.dateTime = dateTimeFromDosDate(entry.dosDate);
+    newInfo.uncompressedSize = entry.uncompressedSize;
+    if (!outZip->open(QIODevice::WriteOnly, newInfo, NULL, entry.crc, method, level, true)) {
+        qDebug() << "Copy of" << entryName << "failed. Cause: outFile.open(): " << outZip->getZipError();
+        inFile.close();
+        return false;
+    }
+    *entryStarted = true;
+
+    // the compressed data is streamed, media entries may be larger than the memory
+    quint64 copied = 0;
+    while (copied < entry.compressedSize) {
+        QByteArray chunk = inFile.read(iZipCopyChunkSize);
+        if (chunk.isEmpty() || outZip->write(chunk) != chunk.size())
+            break;
+        copied += chunk.size();
+    }
+    inFile.close();
+    outZip->close();
+    if (inFile.getZipError() != UNZ_OK || copied != entry.compressedSize || outZip->getZipError() != ZIP_OK) {
+        qDebug() << "Copy of" << entryName << "failed. Cause: inFile.read(): " << inFile.getZipError();
+        return false;
+    }
+
+    reportBytes(entry.uncompressedSize);
+    return true;
+}
+
+bool UBCFFAdaptor::isCanceled() const
+{
+    return mJob && mJob->isCanceled();
+}
+
+void UBCFFAdaptor::reportBytes(qint64 bytes)
+{
+    if (mJob)
+        mJob->reportBytes(bytes);
+}
+
+// Like mkdtemp(): the name is random and the folder is created by a single mkdir, which fails
+// if the name is taken, so conversions running at once in any number of processes never share one
+QString UBCFFAdaptor::createNewTmpDir()
+{
+    QDir tmpRoot(mTmpRoot);
+    if (!tmpRoot.exists() && !QDir().mkpath(tmpRoot.absolutePath())) {
+        qDebug() << "Can't create temporary root dir" << tmpRoot.absolutePath();
+        return QString();
+    }
+
+    for (int attempt = 0; attempt < iTmpDirAttempts; attempt++) {
+        QString dirName = sTmpDirPrefix + QString(QUuid::createUuid().toString()).remove("{").remove("}");
+        if (tmpRoot.mkdir(dirName)) {
+            QString result = tmpRoot.absolutePath() + "/" + dirName;
+            QFile::setPermissions(result, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+            tmpDirs.append(result);
+            return result;
+        }
+        if (!tmpRoot.exists(dirName)) {
+            qDebug() << "Can't create temporary dir maybe due to permissions";
+            return QString();
         }
     }
 
-    return dir.rmdir(pDirPath);
+    qWarning() << "Import failed. Failed to create temporary dir in" << tmpRoot.absolutePath();
+    return QString();
 }
+bool UBCFFAdaptor::deleteDir(const QString& pDirPath) const
+{
+    return UBCFFTmpReaper::removeTree(pDirPath);
+}
+// The folder is handed over to the reaper thread, the conversion doesn't wait for it.
+// At process exit, once the reaper is gone, the folder is deleted right away
 bool UBCFFAdaptor::freeDir(const QString &dir)
 {
-    bool result = true;
-    if (!deleteDir(dir))
-        result = false;
+    QString absoluteDir = QDir(dir).absolutePath();
+    tmpDirs.removeAll(absoluteDir);
 
-    tmpDirs.removeAll(QDir(dir).absolutePath());
+    UBCFFTmpReaper *reaper = UBCFFTmpReaper::instance();
+    if (reaper) {
+        reaper->enqueue(absoluteDir);
+        return true;
+    }
 
-    return result;
+    return deleteDir(absoluteDir);
 }
 void UBCFFAdaptor::freeTmpDirs()
 {
@@ -324,8 +760,17 @@ UBCFFAdaptor::UBToCFFConverter::UBToCFFConverter(const QString &source, const QS
 {
     sourcePath = source;
     destinationPath = destination;
+    mOutputManifest = new UBCFFOutputManifest(destination);
+    mRasterizeTime = 0;
 
     errorStr = noErrorMsg;
+    mPageCount = 0;
+    mPageCache = NULL;
+    mJob = NULL;
+    mOptimizeStrokes = false;
+    mStrokeTolerance = 0;
+    mStrokeElementsIn = mStrokeElementsOut = 0;
+    mStrokePointsBytesIn = mStrokePointsBytesOut = 0;
     mDataModel = new QDomDocument;
     mDocumentToWrite = new QDomDocument; 
     mDocumentToWrite->setContent(QString("<doc></doc>"));
@@ -344,7 +789,7 @@ UBCFFAdaptor::UBToCFFConverter::UBToCFFConverter(const QString &source, const QS
     iwbSVGItemsAttributes.insert(tIWBTspan, iwbSVGTspanAttributes);
 }
 
-bool UBCFFAdaptor::UBToCFFConverter::parse()
+bool UBCFFAdaptor::UBToCFFConverter::parse(QIODevice *contentDevice)
 {
     if(!isValid()) {
         qDebug() << "document metadata is not valid. Can't parse";
@@ -353,14 +798,13 @@ bool UBCFFAdaptor::UBToCFFConverter::parse()
 
     qDebug() << "begin parsing ubz";
 
-    QFile outFile(contentIWBFileName());
-    if (!outFile.open(QIODevice::WriteOnly| QIODevice::Text)) {
+    if (!contentDevice || !contentDevice->isWritable()) {
         qDebug() << "can't open output file for writing";
         errorStr = "createXMLOutputPatternError";
         return false;
     }
 
-    mIWBContentWriter->setDevice(&outFile);
+    mIWBContentWriter->setDevice(contentDevice);
 
     mIWBContentWriter->writeStartDocument();
     mIWBContentWriter->writeStartElement(tIWBRoot);
@@ -372,22 +816,18 @@ bool UBCFFAdaptor::UBToCFFConverter::parse()
     if (!parseMetadata()) {
         if (errorStr == noErrorMsg)
             errorStr = "MetadataParsingError";
-
-        outFile.close();
         return false;
     }
 
     if (!parseContent()) {
         if (errorStr == noErrorMsg)
             errorStr = "ContentParsingError";
-        outFile.close();
         return false;
     }
 
     mIWBContentWriter->writeEndElement();
     mIWBContentWriter->writeEndDocument();
-
-    outFile.close();
+    mIWBContentWriter->setDevice(NULL);
 
     qDebug() << "finished with success";
 
@@ -449,6 +889,9 @@ bool UBCFFAdaptor::UBToCFFConverter::parseMetadata()
                         return false;
                     }
                 } else {
+                    if (nextInElement.tagName() == tUBZPageCount)
+                        mPageCount = textContent.trimmed().toInt();
+
                     mIWBContentWriter->writeStartElement(iwbNS, tIWBMeta);
                     mIWBContentWriter->writeAttribute(aIWBName, nextInElement.tagName());
                     mIWBContentWriter->writeAttribute(aIWBContent, textContent);
@@ -463,12 +906,64 @@ bool UBCFFAdaptor::UBToCFFConverter::parseMetadata()
     metaDataFile.close();
     return true;
 }
-bool UBCFFAdaptor::UBToCFFConverter::parseContent() {
+// Page list comes from the archive central directory (zip input), from the page count
+// in metadata.rdf or, for older documents, from a listing of the source folder.
+// Pages are ordered by their number, not by name, so page1000.svg follows page999.svg
+QStringList UBCFFAdaptor::UBToCFFConverter::getPageFileNames()
+{
+    if (!mPageFileNames.isEmpty())
+        return sortPageFileNames(mPageFileNames);
+
+    if (0 < mPageCount) {
+        int firstPage = QFile::exists(sourcePath + "/" + pageAlias + digitFileFormat(0) + "." + pageFileExtentionUBZ) ? 0 : 1;
+        QString lastPageFile = pageAlias + digitFileFormat(firstPage + mPageCount - 1) + "." + pageFileExtentionUBZ;
+        if (QFile::exists(sourcePath + "/" + lastPageFile)) {
+            QStringList pageList;
+            for (int i = firstPage; i < firstPage + mPageCount; i++)
+                pageList << pageAlias + digitFileFormat(i) + "." + pageFileExtentionUBZ;
+            return pageList;
+        }
+        qDebug() << "page count from metadata doesn't match page files, looking for pages in" << sourcePath;
+    }
 
-    QDir sourceDir(sourcePath);
     QStringList fileFilters;
-    fileFilters << QString(pageAlias + "???." + pageFileExtentionUBZ);
-    QStringList pageList = sourceDir.entryList(fileFilters, QDir::Files, QDir::Name | QDir::IgnoreCase);
+    fileFilters << QString(pageAlias + "*." + pageFileExtentionUBZ);
+    return sortPageFileNames(QDir(sourcePath).entryList(fileFilters, QDir::Files, QDir::NoSort));
+}
+
+QStringList UBCFFAdaptor::UBToCFFConverter::sortPageFileNames(const QStringList &fileNames)
+{
+    QMap<int, QString> pagesByNumber;
+    foreach (QString fileName, fileNames) {
+        int pageNumber = getPageNumberFromFileName(fileName);
+        if (0 <= pageNumber)
+            pagesByNumber.insert(pageNumber, fileName);
+    }
+    return pagesByNumber.values();
+}
+
+int UBCFFAdaptor::UBToCFFConverter::getPageNumberFromFileName(const QString &fileName)
+{
+    // page<digits>.svg in the document root only
+    QString suffix = "." + pageFileExtentionUBZ;
+    if (!fileName.startsWith(pageAlias, Qt::CaseInsensitive) || !fileName.endsWith(suffix, Qt::CaseInsensitive))
+        return -1;
+
+    QString digits = fileName.mid(pageAlias.length(), fileName.length() - pageAlias.length() - suffix.length());
+    if (digits.isEmpty())
+        return -1;
+    for (int i = 0; i < digits.length(); i++)
+        if (!digits.at(i).isDigit())
+            return -1;
+
+    bool ok = false;
+    int pageNumber = digits.toInt(&ok);
+    return ok ? pageNumber : -1;
+}
+
+bool UBCFFAdaptor::UBToCFFConverter::parseContent() {
+
+    QStringList pageList = getPageFileNames();
 
     QDomElement svgDocumentSection = mDataModel->createElementNS(svgIWBNS, ":"+tSvg);
 
@@ -498,6 +993,9 @@ bool UBCFFAdaptor::UBToCFFConverter::parseContent() {
 
     writeQDomElementToXML(svgDocumentSection);
 
+    if (mOptimizeStrokes)
+        qDebug() << "stroke optimization: elements" << mStrokeElementsIn << "->" << mStrokeElementsOut
+                 << ", points bytes" << mStrokePointsBytesIn << "->" << mStrokePointsBytesOut;
 
     if (!writeExtendedIwbSection()) {
         if (errorStr == noErrorMsg)
@@ -512,6 +1010,8 @@ QDomElement UBCFFAdaptor::UBToCFFConverter::parsePage(const QString &pageFileNam
 {
     qDebug() << "begin parsing page" + pageFileName;
     mSvgElements.clear(); //clean Svg elements map before parsing new page
+    mPageMediaFiles.clear();
+    mPageViewbox = QRect();
 
     int errorLine, errorColumn;
 
@@ -556,6 +1056,43 @@ QDomElement UBCFFAdaptor::UBToCFFConverter::parsePage(const QString &pageFileNam
     return page.hasChildNodes() ? page : QDomElement();
 }
 
+QDomElement UBCFFAdaptor::UBToCFFConverter::restorePageFromCache(const QString &pageKey)
+{
+    QList<QDomElement> extendedElements;
+    QRect pageViewbox;
+    QStringList mediaFiles;
+
+    QDomElement page = mPageCache->restorePage(pageKey, mDocumentToWrite, extendedElements, pageViewbox, mediaFiles);
+    if (page.isNull())
+        return page;
+
+    qDebug() << "page is not changed since the previous conversion, taking it from cache";
+    setViewBox(pageViewbox);
+    foreach (QDomElement extendedElement, extendedElements)
+        addIWBElementToResultModel(extendedElement);
+    mReusedMediaFiles << mediaFiles;
+
+    return page;
+}
+
+bool UBCFFAdaptor::UBToCFFConverter::isCanceled() const
+{
+    return mJob && mJob->isCanceled();
+}
+
+// Everything besides the page sources the conversion of a page depends on.
+// Page backgrounds are sized by the viewbox of all the pages before it.
+QString UBCFFAdaptor::UBToCFFConverter::pageCacheContext() const
+{
+    return QString("%1 %2 %3 %4 strokes=%5,%6 precision=%7").arg(mViewbox.x())
+                                                            .arg(mViewbox.y())
+                                                            .arg(mViewbox.width())
+                                                            .arg(mViewbox.height())
+                                                            .arg(mOptimizeStrokes)
+                                                            .arg(mStrokeTolerance)
+                                                            .arg(mPrecisionPolicy.key());
+}
+
 QDomElement UBCFFAdaptor::UBToCFFConverter::parsePageset(const QStringList &pageFileNames)
 {   
     QMultiMap<int, QDomElement> pageList;
@@ -565,12 +1102,31 @@ QDomElement UBCFFAdaptor::UBToCFFConverter::parsePageset(const QStringList &page
 
     while (curPage.hasNext()) {
 
+        if (isCanceled()) {
+            errorStr = "ConversionCanceled";
+            return QDomElement();
+        }
+
         QString curPageFile = curPage.next();
-        QDomElement iterElement = parsePage(curPageFile);
+        QDomElement iterElement;
+        QString pageKey;
+        if (mPageCache) {
+            pageKey = mPageCache->pageKey(sourcePath, curPageFile, pageCacheContext());
+            iterElement = restorePageFromCache(pageKey);
+        }
+        if (iterElement.isNull()) {
+            int firstExtendedElement = mExtendedElements.count();
+            iterElement = parsePage(curPageFile);
+            if (mPageCache && !iterElement.isNull())
+                mPageCache->storePage(pageKey, curPageFile, iterElement, mExtendedElements.mid(firstExtendedElement),
+                                      mPageViewbox, mPageMediaFiles, destinationPath);
+        }
         if (!iterElement.isNull())           
         {
             iterElement.setAttribute(tId, iPageNo);
             addSVGElementToResultModel(iterElement, pageList, iPageNo);
+            if (mJob)
+                mJob->reportPages(iPageNo, pageFileNames.count());
             iPageNo++; 
         }
         else
@@ -599,7 +1155,8 @@ QDomElement UBCFFAdaptor::UBToCFFConverter::parseSvgPageSection(const QDomElemen
 
     //getting current page viewbox to be able to convert coordinates to global viewbox parameter
     if (element.hasAttribute(aUBZViewBox)) {
-        setViewBox(getViewboxRect(element.attribute(aUBZViewBox)));
+        mPageViewbox = getViewboxRect(element.attribute(aUBZViewBox));
+        setViewBox(mPageViewbox);
     }
 
     QMultiMap<int, QDomElement> svgElements;
@@ -641,31 +1198,54 @@ QDomElement UBCFFAdaptor::UBToCFFConverter::parseSvgPageSection(const QDomElemen
     return svgElementPart.hasChildNodes() ? svgElementPart : QDomElement();
 }
 
+void UBCFFAdaptor::UBToCFFConverter::setCompactOutput(bool compact)
+{
+    mIWBContentWriter->setAutoFormatting(!compact);
+}
+
+// Walks the subtree without recursion: goes down to the first child, then to
+// the next sibling, and climbs up closing elements when a level is exhausted.
 void UBCFFAdaptor::UBToCFFConverter::writeQDomElementToXML(const QDomNode &node)
 {
-    if (!node.isNull())
-    if (node.isText())
-    {     
-        mIWBContentWriter->writeCharacters(node.nodeValue());
-    }   
-    else
+    QDomNode current = node;
+    while (!current.isNull())
     {
-        mIWBContentWriter->writeStartElement(node.namespaceURI(), node.toElement().tagName());
-
-        for (int i = 0; i < node.toElement().attributes().count(); i++)
+        if (current.isText())
         {
-            QDomAttr attr =  node.toElement().attributes().item(i).toAttr();
-            mIWBContentWriter->writeAttribute(attr.name(), attr.value());
+            mIWBContentWriter->writeCharacters(current.nodeValue());
         }
-        QDomNode child = node.firstChild();
-        while(!child.isNull())
+        else
         {
-            writeQDomElementToXML(child);
-            child = child.nextSibling();
+            QDomElement element = current.toElement();
+            mIWBContentWriter->writeStartElement(element.namespaceURI(), element.tagName());
+
+            QDomNamedNodeMap attributes = element.attributes();
+            int attributesCount = attributes.count();
+            for (int i = 0; i < attributesCount; i++)
+            {
+                QDomAttr attr = attributes.item(i).toAttr();
+                mIWBContentWriter->writeAttribute(attr.name(), attr.value());
+            }
+
+            QDomNode child = current.firstChild();
+            if (!child.isNull())
+            {
+                current = child;
+                continue;
+            }
+            mIWBContentWriter->writeEndElement();
         }
 
-        mIWBContentWriter->writeEndElement();
-    }       
+        while (current != node && current.nextSibling().isNull())
+        {
+            current = current.parentNode();
+            mIWBContentWriter->writeEndElement();
+        }
+        if (current == node)
+            break;
+
+        current = current.nextSibling();
+    }
 }
 
 bool UBCFFAdaptor::UBToCFFConverter::writeExtendedIwbSection()
@@ -907,10 +1487,8 @@ bool UBCFFAdaptor::UBToCFFConverter::ibwAddLine(int x1, int y1, int x2, int y2,
 {
     bool bRet = true;
 
-    QDomDocument doc;
-
-    QDomElement svgBackgroundCrossPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":line");
-    QDomElement iwbBackgroundCrossPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgBackgroundCrossPart = createSvgElement("line");
+    QDomElement iwbBackgroundCrossPart = createIwbElement();
 
     QString sUUID = QUuid::createUuid().toString().remove("{").remove("}");
 
@@ -949,44 +1527,26 @@ QTransform UBCFFAdaptor::UBToCFFConverter::getTransformFromUBZ(const QDomElement
 {
     QTransform trRet;
   
-    QStringList transformParameters;
-
+    // matrix(a,b,c,d,e,f)
     QString ubzTransform = ubzElement.attribute(aTransform);
-    ubzTransform.remove("matrix");
-    ubzTransform.remove("(");
-    ubzTransform.remove(")");
+    int argumentsBegin = ubzTransform.indexOf('(') + 1;
+    int argumentsEnd = ubzTransform.lastIndexOf(')');
+    if (argumentsEnd < argumentsBegin)
+        argumentsEnd = ubzTransform.length();
 
-    transformParameters = ubzTransform.split(",", QString::SkipEmptyParts);
+    QVector<qreal> transformParameters;
+    UBCFFNumericCodec::parseNumberList(ubzTransform.mid(argumentsBegin, argumentsEnd - argumentsBegin), transformParameters);
 
     if (6 <= transformParameters.count())
     {
-        QTransform *tr = NULL;
-        tr = new QTransform(transformParameters.at(0).toDouble(),
-            transformParameters.at(1).toDouble(),
-            transformParameters.at(2).toDouble(),
-            transformParameters.at(3).toDouble(),
-            transformParameters.at(4).toDouble(),
-            transformParameters.at(5).toDouble());
-
-        trRet = *tr;
-        
-        delete tr;
+        trRet = QTransform(transformParameters.at(0),
+            transformParameters.at(1),
+            transformParameters.at(2),
+            transformParameters.at(3),
+            transformParameters.at(4),
+            transformParameters.at(5));
     }
 
-    if (6 <= transformParameters.count())
-    {
-        QTransform *tr = NULL;
-        tr = new QTransform(transformParameters.at(0).toDouble(),
-            transformParameters.at(1).toDouble(),
-            transformParameters.at(2).toDouble(),
-            transformParameters.at(3).toDouble(),
-            transformParameters.at(4).toDouble(),
-            transformParameters.at(5).toDouble());
-
-        trRet = *tr;
-        
-        delete tr;
-    }
     return trRet;
 }
 
@@ -1016,10 +1576,10 @@ void UBCFFAdaptor::UBToCFFConverter::setCoordinatesFromUBZ(const QDomElement &ub
     if (QString() != ubzElement.attribute(aTransform))
         tr = getTransformFromUBZ(ubzElement);
 
-    qreal x = ubzElement.attribute(aX).toDouble();
-    qreal y = ubzElement.attribute(aY).toDouble();
-    qreal height = ubzElement.attribute(aHeight).toDouble();
-    qreal width = ubzElement.attribute(aWidth).toDouble();
+    qreal x = UBCFFNumericCodec::parseNumber(ubzElement.attribute(aX));
+    qreal y = UBCFFNumericCodec::parseNumber(ubzElement.attribute(aY));
+    qreal height = UBCFFNumericCodec::parseNumber(ubzElement.attribute(aHeight));
+    qreal width = UBCFFNumericCodec::parseNumber(ubzElement.attribute(aWidth));
 
     qreal alpha = getAngleFromTransform(tr);
  
@@ -1031,13 +1591,19 @@ void UBCFFAdaptor::UBToCFFConverter::setCoordinatesFromUBZ(const QDomElement &ub
     item.setRotation(-alpha);
     QMatrix sceneMatrix = item.sceneMatrix();
  
-    iwbElement.setAttribute(aX, x);
-    iwbElement.setAttribute(aY, y);
-    iwbElement.setAttribute(aHeight, height*sceneMatrix.m22());
-    iwbElement.setAttribute(aWidth, width*sceneMatrix.m11());
-    iwbElement.setAttribute(aTransform, QString("rotate(%1) translate(%2,%3)").arg(alpha)
-                                                                              .arg(sceneMatrix.dx())
-                                                                              .arg(sceneMatrix.dy()));
+    iwbElement.setAttribute(aX, mPrecisionPolicy.format(x, UBCFFPrecisionPolicy::Coordinate));
+    iwbElement.setAttribute(aY, mPrecisionPolicy.format(y, UBCFFPrecisionPolicy::Coordinate));
+    iwbElement.setAttribute(aHeight, mPrecisionPolicy.format(height*sceneMatrix.m22(), UBCFFPrecisionPolicy::Size));
+    iwbElement.setAttribute(aWidth, mPrecisionPolicy.format(width*sceneMatrix.m11(), UBCFFPrecisionPolicy::Size));
+
+    QString transform("rotate(");
+    mPrecisionPolicy.appendNumber(transform, alpha, UBCFFPrecisionPolicy::Angle);
+    transform += ") translate(";
+    mPrecisionPolicy.appendNumber(transform, sceneMatrix.dx(), UBCFFPrecisionPolicy::Coordinate);
+    transform += ",";
+    mPrecisionPolicy.appendNumber(transform, sceneMatrix.dy(), UBCFFPrecisionPolicy::Coordinate);
+    transform += ")";
+    iwbElement.setAttribute(aTransform, transform);
 }
 
 bool UBCFFAdaptor::UBToCFFConverter::setContentFromUBZ(const QDomElement &ubzElement, QDomElement &svgElement)
@@ -1061,9 +1627,6 @@ bool UBCFFAdaptor::UBToCFFConverter::setContentFromUBZ(const QDomElement &ubzEle
     {
         sSrcFileName = sourcePath + "/" + sSrcContentFolder + "/" + getFileNameFromPath(srcPath); // some elements must be exported as images, so we take hes existing thumbnails.
 
-        QFile srcFile;
-        srcFile.setFileName(sSrcFileName);
-
         QDir dstDocFolder(destinationPath);
 
         if (!dstDocFolder.exists(sDstContentFolder))
@@ -1071,8 +1634,9 @@ bool UBCFFAdaptor::UBToCFFConverter::setContentFromUBZ(const QDomElement &ubzEle
 
         if (bRet)
         {
-            QString dstFilePath = destinationPath+"/"+sDstContentFolder+"/"+sDstFileName;
-            bRet &= srcFile.copy(dstFilePath);
+            bRet &= mOutputManifest->copyFile(sSrcFileName, sDstContentFolder+"/"+sDstFileName);
+            if (bRet)
+                mPageMediaFiles << sDstContentFolder+"/"+sDstFileName;
         }
 
         if (bRet)
@@ -1095,8 +1659,9 @@ bool UBCFFAdaptor::UBToCFFConverter::setContentFromUBZ(const QDomElement &ubzEle
             {
                 if (feSvg == fileExtention) // svg images must be converted to PNG.
                 {           
-                    QString dstFilePath = destinationPath+"/"+sDstContentFolder+"/"+sDstFileName;
-                    bRet &= createPngFromSvg(sSrcFileName, dstFilePath, getTransformFromUBZ(ubzElement));
+                    bRet &= createPngFromSvg(sSrcFileName, sDstContentFolder+"/"+sDstFileName, getTransformFromUBZ(ubzElement));
+                    if (bRet)
+                        mPageMediaFiles << sDstContentFolder+"/"+sDstFileName;
                 }
                 else
                     bRet = false;
@@ -1121,81 +1686,132 @@ bool UBCFFAdaptor::UBToCFFConverter::setContentFromUBZ(const QDomElement &ubzEle
     return bRet;
 }
 
-void UBCFFAdaptor::UBToCFFConverter::setCFFTextFromHTMLTextNode(const QDomElement htmlTextNode,  QDomElement &iwbElement)
+// Inline styles of the spans repeat a lot: a text usually has a handful of distinct
+// styles over all its spans. A style string is parsed once into the tspan attributes it gives.
+const QList<QPair<QString, QString> > &UBCFFAdaptor::UBToCFFConverter::tspanStyleAttributes(const QString &style)
 {
+    QHash<QString, QList<QPair<QString, QString> > >::const_iterator cached = mTspanStyleCache.constFind(style);
+    if (cached != mTspanStyleCache.constEnd())
+        return cached.value();
 
-    QDomDocument textDoc;
-               
-    QDomElement textParentElement = iwbElement;
+    // html attributes like: style="font-size:40pt; color:"red";".
+    QList<QPair<QString, QString> > attributes;
+    QStringList cffAttributes = style.split(";", QString::SkipEmptyParts);
+    for (int i = 0; i < cffAttributes.count(); i++)
+    {
+        QString attr = cffAttributes.at(i).trimmed();
+        QStringList AttrVal = attr.split(":", QString::SkipEmptyParts);
+        if (1 < AttrVal.count())
+        {
+            QString sAttr = ubzAttrNameToCFFAttrName(AttrVal.at(0));
+            if (itIsSVGElementAttribute(tIWBTspan, sAttr))
+                attributes.append(qMakePair(sAttr, ubzAttrValueToCFFAttrName(AttrVal.at(1))));
+        }
+    }
 
-    QString textString;
-    QDomNode htmlPNode =  htmlTextNode.firstChild();
-    bool bTbreak = false;
+    return mTspanStyleCache.insert(style, attributes).value();
+}
+
+// Converts the html of a text item in one pass over it, without building its DOM.
+// Every block (<p>) of the html body is a line of the svg text element, lines are split
+// by <tbreak>. Text of a block goes to the text element, its inline elements (<span>)
+// become <tspan> with the attributes of the block and the ones from their style.
+// Returns the concatenated attribute values of <body>, the common style of the text.
+QString UBCFFAdaptor::UBToCFFConverter::setCFFTextFromHTML(const QString &html, QDomElement &svgTextElement)
+{
+    QString bodyStyle;
 
-    // reads HTML text strings - each string placed in separate <p> section 
-    while(!htmlPNode.isNull())
-    {  
-        // add <tbreak> for split strings
-        if (bTbreak)
+    QXmlStreamReader htmlReader(html);
+    int depth = 0;
+    int bodyDepth = -1;
+    bool firstBlock = true;
+    QXmlStreamAttributes blockAttributes;
+    QDomElement spanElement;
+    bool spanTextPending = false;
+    QString spanText;
+
+    while (!htmlReader.atEnd())
+    {
+        QXmlStreamReader::TokenType token = htmlReader.readNext();
+
+        // only the first text node of a span is its text
+        if (spanTextPending && QXmlStreamReader::Characters != token)
         {
-            bTbreak = false;
-            
-            QDomElement tbreakNode = textDoc.createElementNS(svgIWBNS, svgIWBNSPrefix+":"+tIWBTbreak);
-            textParentElement.appendChild(tbreakNode.cloneNode(true));
+            if (!spanText.isEmpty() || QXmlStreamReader::StartElement == token || QXmlStreamReader::EndElement == token)
+            {
+                spanElement.appendChild(createTextNode(spanText));
+                spanTextPending = false;
+            }
         }
 
-        QDomNode spanNode = htmlPNode.firstChild();
-
-       
-        while (!spanNode.isNull())
+        if (QXmlStreamReader::StartElement == token)
         {
-            if (spanNode.isText())
+            depth++;
+            if (-1 == bodyDepth)
             {
-                QDomText nodeText = textDoc.createTextNode(spanNode.nodeValue());
-                textParentElement.appendChild(nodeText.cloneNode(true));
+                if (QLatin1String("body") == htmlReader.name())
+                {
+                    bodyDepth = depth;
+                    foreach (QXmlStreamAttribute attribute, htmlReader.attributes())
+                        bodyStyle += " " + attribute.value().toString();
+                }
             }
-            else
-            if (spanNode.isElement())
-            {      
-                QDomElement pElementIwb;
-                QDomElement spanElement = textDoc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBTspan);
-                setCommonAttributesFromUBZ(htmlPNode.toElement(), pElementIwb, spanElement);
-
-                if (spanNode.hasAttributes())
-                {       
-                    int attrCount = spanNode.attributes().count();
-                    if (0 < attrCount)
-                    {
-                        for (int i = 0; i < attrCount; i++)
-                        {
-                            // html attributes like: style="font-size:40pt; color:"red";".
-                            QStringList cffAttributes = spanNode.attributes().item(i).nodeValue().split(";", QString::SkipEmptyParts);
-                            {
-                                for (int i = 0; i < cffAttributes.count(); i++)
-                                {                       
-                                    QString attr = cffAttributes.at(i).trimmed();
-                                    QStringList AttrVal = attr.split(":", QString::SkipEmptyParts);
-                                    if(1 < AttrVal.count())
-                                    {    
-                                        QString sAttr = ubzAttrNameToCFFAttrName(AttrVal.at(0));
-                                        if (itIsSVGElementAttribute(spanElement.tagName(), sAttr))
-                                            spanElement.setAttribute(sAttr, ubzAttrValueToCFFAttrName(AttrVal.at(1)));
-                                    }
-                                }
-                            }
-                        }
-                    }
+            else if (bodyDepth + 1 == depth) // block
+            {
+                if (!firstBlock)
+                    svgTextElement.appendChild(createSvgElement(tIWBTbreak));
+                firstBlock = false;
+                blockAttributes = htmlReader.attributes();
+            }
+            else if (bodyDepth + 2 == depth) // span
+            {
+                spanElement = createSvgElement(tIWBTspan);
+
+                foreach (QXmlStreamAttribute attribute, blockAttributes)
+                {
+                    QString sAttr = ubzAttrNameToCFFAttrName(attribute.name().toString());
+                    if (!itIsIWBAttribute(sAttr) && !itIsUBZAttributeToConvert(sAttr) && itIsSVGElementAttribute(tIWBTspan, sAttr))
+                        spanElement.setAttribute(sAttr, ubzAttrValueToCFFAttrName(attribute.value().toString()));
                 }
-                QDomText nodeText = textDoc.createTextNode(spanNode.firstChild().nodeValue());                    
-                spanElement.appendChild(nodeText);
-                textParentElement.appendChild(spanElement.cloneNode(true));
+
+                typedef QPair<QString, QString> StyleAttribute;
+                foreach (QXmlStreamAttribute attribute, htmlReader.attributes())
+                    foreach (const StyleAttribute &styleAttribute, tspanStyleAttributes(attribute.value().toString()))
+                        spanElement.setAttribute(styleAttribute.first, styleAttribute.second);
+
+                svgTextElement.appendChild(spanElement);
+                spanTextPending = true;
+                spanText.clear();
+            }
+        }
+        else if (QXmlStreamReader::EndElement == token)
+        {
+            if (bodyDepth == depth)
+                break;
+            depth--;
+        }
+        else if (QXmlStreamReader::Characters == token && !htmlReader.isWhitespace())
+        {
+            if (spanTextPending && bodyDepth + 2 == depth)
+                spanText += htmlReader.text().toString();
+            else if (bodyDepth + 1 == depth) // text of a block
+                svgTextElement.appendChild(createTextNode(htmlReader.text().toString()));
+            else if (bodyDepth == depth) // text right in the body is a block too
+            {
+                if (!firstBlock)
+                    svgTextElement.appendChild(createSvgElement(tIWBTbreak));
+                firstBlock = false;
             }
-            spanNode = spanNode.nextSibling();
         }
-
-    bTbreak = true;
-    htmlPNode = htmlPNode.nextSibling();
     }
+
+    if (spanTextPending)
+        spanElement.appendChild(createTextNode(spanText));
+
+    if (htmlReader.hasError())
+        qDebug() << "|error at text html parsing:" << htmlReader.errorString();
+
+    return bodyStyle;
 }
 
 QString UBCFFAdaptor::UBToCFFConverter::ubzAttrNameToCFFAttrName(QString cffAttrName)
@@ -1247,7 +1863,10 @@ bool UBCFFAdaptor::UBToCFFConverter::setCFFAttribute(const QString &attributeNam
     else
     if (itIsSVGElementAttribute(svgElement.tagName(),attributeName))
     {
-            svgElement.setAttribute(attributeName,  attributeValue);
+        if (aPoints == attributeName)
+            svgElement.setAttribute(attributeName, convertPoints(attributeValue));
+        else
+            svgElement.setAttribute(attributeName, convertGeometryValue(attributeName, attributeValue));
     }
 
     if (bNeedsIWBSection)  
@@ -1319,51 +1938,14 @@ QDomNode UBCFFAdaptor::UBToCFFConverter::findTextNode(const QDomNode &node)
     return iterNode;
 }
 
-QDomNode UBCFFAdaptor::UBToCFFConverter::findNodeByTagName(const QDomNode &node, QString tagName)
-{
-    QDomNode iterNode = node;
-
-    while (!iterNode.isNull())
-    {       
-        QString t = iterNode.toElement().tagName();
-        if (tagName == t)
-            return iterNode;
-        else 
-        {
-            if (!iterNode.firstChildElement().isNull())
-            {
-                QDomNode foundNode = findNodeByTagName(iterNode.firstChildElement(), tagName);
-                if (!foundNode.isNull()){
-                    if (foundNode.isElement())
-                    {
-                        if (tagName == foundNode.toElement().tagName())
-                            return foundNode;
-                    }
-                    else
-                        break;
-                }
-            }
-        }
-        
-        if (!iterNode.nextSibling().isNull())
-            iterNode = iterNode.nextSibling();
-        else 
-            break;
-    }
-    return QDomNode();
-
-}
-
 bool UBCFFAdaptor::UBToCFFConverter::createBackground(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList)
 {
     qDebug() << "|creating element background";
 
 
-    QDomDocument doc;
-
-    //QDomElement svgBackgroundElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tUBZImage);
-    QDomElement svgBackgroundElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBRect);
-    QDomElement iwbBackgroundElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    //QDomElement svgBackgroundElementPart = createSvgElement(tUBZImage);
+    QDomElement svgBackgroundElementPart = createSvgElement(tIWBRect);
+    QDomElement iwbBackgroundElementPart = createIwbElement();
 
 
     QRect bckRect(mViewbox);
@@ -1420,9 +2002,9 @@ QString UBCFFAdaptor::UBToCFFConverter::createBackgroundImage(const QDomElement
 
     QString dstFilePath;
     if (bDirExists)
-        dstFilePath = destinationPath+"/"+cfImages+"/"+sDstFileName;
+        dstFilePath = cfImages+"/"+sDstFileName;
 
-    if (!QFile().exists(dstFilePath))
+    if (!mOutputManifest->contains(dstFilePath))
     {
         QRect rect(0,0, size.width(), size.height());
 
@@ -1462,8 +2044,11 @@ QString UBCFFAdaptor::UBToCFFConverter::createBackgroundImage(const QDomElement
         painter->end();
         painter->save();
         
+        QByteArray imageData;
+        QBuffer imageBuffer(&imageData);
+        imageBuffer.open(QIODevice::WriteOnly);
         if (QString() != dstFilePath)
-           if (bckImage->save(dstFilePath))
+           if (bckImage->save(&imageBuffer, "PNG") && mOutputManifest->writeFile(dstFilePath, imageData))
                sRet = cfImages+"/"+sDstFileName;
 
         delete bckImage;
@@ -1475,10 +2060,16 @@ QString UBCFFAdaptor::UBToCFFConverter::createBackgroundImage(const QDomElement
     return sRet;
 }
 
-bool UBCFFAdaptor::UBToCFFConverter::createPngFromSvg(QString &svgPath, QString &dstPath, QTransform transformation, QSize size)
+bool UBCFFAdaptor::UBToCFFConverter::createPngFromSvg(QString &svgPath, const QString &dstPath, QTransform transformation, QSize size)
 {
+    if (isCanceled())
+        return false;
+
     if (QFile().exists(svgPath))
     {
+        QElapsedTimer timer;
+        timer.start();
+
         QImage i(svgPath);
 
         QSize iSize = (QSize() == size)?QSize(i.size().width()*transformation.m11(), i.size().height()*transformation.m22()):size;
@@ -1489,7 +2080,13 @@ bool UBCFFAdaptor::UBToCFFConverter::createPngFromSvg(QString &svgPath, QString
         QSvgRenderer renderer(svgPath);  
         renderer.render(&imagePainter);     
       
-        return image.save(dstPath);
+        QByteArray imageData;
+        QBuffer imageBuffer(&imageData);
+        imageBuffer.open(QIODevice::WriteOnly);
+        bool created = image.save(&imageBuffer, "PNG") && mOutputManifest->writeFile(dstPath, imageData);
+
+        mRasterizeTime += timer.nsecsElapsed();
+        return created;
 
     }
     else 
@@ -1509,9 +2106,8 @@ bool UBCFFAdaptor::UBToCFFConverter::parseSVGGGroup(const QDomElement &element,
 
     QMultiMap<int, QDomElement> svgElements;
 
-    QDomDocument doc;
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBG);
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(tIWBG);
+    QDomElement iwbElementPart = createIwbElement();
     
     // Elements can know about its layer, so it must add result QDomElements to ordrered list.
     while (!nextElement.isNull()) {
@@ -1523,6 +2119,9 @@ bool UBCFFAdaptor::UBToCFFConverter::parseSVGGGroup(const QDomElement &element,
         nextElement = nextElement.nextSiblingElement();
     }
 
+    if (mOptimizeStrokes)
+        optimizeStrokes(svgElements);
+
     QList<int> layers;
     QMapIterator<int, QDomElement> nextSVGElement(svgElements);
     while (nextSVGElement.hasNext()) 
@@ -1539,14 +2138,222 @@ bool UBCFFAdaptor::UBToCFFConverter::parseSVGGGroup(const QDomElement &element,
  
     return true;
 }
+// Sankore draws a pen segment as a quad: the segment line shifted by half the pen width
+// to both sides, p1 p2 going forward along one side and p3 p4 back along the other.
+// Gives the segment centre line and width, false if the polygon is not such a quad.
+static bool strokeSegmentFromQuad(const QVector<qreal> &points, QPointF &start, QPointF &end, qreal &width)
+{
+    int count = points.count() / 2;
+    if (5 == count && points.at(0) == points.at(8) && points.at(1) == points.at(9))
+        count = 4; // closed explicitly
+    if (4 != count || points.count() % 2)
+        return false;
+
+    QPointF p1(points.at(0), points.at(1));
+    QPointF p2(points.at(2), points.at(3));
+    QPointF p3(points.at(4), points.at(5));
+    QPointF p4(points.at(6), points.at(7));
+
+    QLineF startSide(p1, p4);
+    QLineF endSide(p2, p3);
+    width = startSide.length();
+    if (qFuzzyIsNull(width) || qAbs(width - endSide.length()) > width*0.01)
+        return false;
+
+    // both ends are cut across the same direction
+    QPointF startVector = p4 - p1;
+    QPointF endVector = p3 - p2;
+    qreal cross = startVector.x()*endVector.y() - startVector.y()*endVector.x();
+    if (qAbs(cross) > width*width*0.01)
+        return false;
+
+    start = (p1 + p4) / 2;
+    end = (p2 + p3) / 2;
+    return true;
+}
+
+// Douglas-Peucker: keeps the points deviating from the simplified line by more than tolerance
+static QVector<QPointF> simplifyPolyline(const QVector<QPointF> &points, qreal tolerance)
+{
+    if (points.count() < 3 || tolerance <= 0)
+        return points;
+
+    QVector<bool> keep(points.count(), false);
+    keep[0] = keep[points.count() - 1] = true;
+
+    QStack<QPair<int, int> > ranges;
+    ranges.push(qMakePair(0, points.count() - 1));
+    while (!ranges.isEmpty()) {
+        QPair<int, int> range = ranges.pop();
+        const QPointF &first = points.at(range.first);
+        const QPointF &last = points.at(range.second);
+        QPointF direction = last - first;
+        qreal length = sqrt(direction.x()*direction.x() + direction.y()*direction.y());
+
+        qreal maxDistance = 0;
+        int farthest = -1;
+        for (int i = range.first + 1; i < range.second; i++) {
+            QPointF offset = points.at(i) - first;
+            qreal distance = qFuzzyIsNull(length)
+                    ? sqrt(offset.x()*offset.x() + offset.y()*offset.y())
+                    : qAbs(direction.x()*offset.y() - direction.y()*offset.x()) / length;
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = i;
+            }
+        }
+
+        if (farthest != -1 && maxDistance > tolerance) {
+            keep[farthest] = true;
+            ranges.push(qMakePair(range.first, farthest));
+            ranges.push(qMakePair(farthest, range.second));
+        }
+    }
+
+    QVector<QPointF> simplified;
+    for (int i = 0; i < points.count(); i++)
+        if (keep.at(i))
+            simplified.append(points.at(i));
+    return simplified;
+}
+
+// Everything but the geometry, elements with the same key can be drawn as one shape
+QString UBCFFAdaptor::UBToCFFConverter::strokeStyleKey(const QDomElement &element) const
+{
+    QStringList style;
+    QDomNamedNodeMap attributes = element.attributes();
+    for (int i = 0; i < attributes.count(); i++) {
+        QDomNode attribute = attributes.item(i);
+        if (attribute.nodeName() != aPoints)
+            style << attribute.nodeName() + "=" + attribute.nodeValue();
+    }
+    style.sort();
+    return style.join(";");
+}
+
+QDomElement UBCFFAdaptor::UBToCFFConverter::createStrokePolyline(const QList<QDomElement> &segments, const QVector<QPointF> &centerline, qreal width)
+{
+    const QDomElement &firstSegment = segments.first();
+    QDomElement polyline = createSvgElement(tIWBPolyLine);
+
+    //a polyline is filled black by default, the round ends of the segments become round caps and joins
+    polyline.setAttribute(aFill, avNone);
+    polyline.setAttribute(aStroke, firstSegment.attribute(aFill, "black"));
+    polyline.setAttribute(aStrokeWidth, mPrecisionPolicy.format(width, UBCFFPrecisionPolicy::Size));
+    polyline.setAttribute(aStrokeLineCap, avRound);
+    polyline.setAttribute(aStrokeLineJoin, avRound);
+    if (firstSegment.hasAttribute(aFillOpacity))
+        polyline.setAttribute(aStrokeOpacity, firstSegment.attribute(aFillOpacity));
+    if (firstSegment.hasAttribute(aTransform))
+        polyline.setAttribute(aTransform, firstSegment.attribute(aTransform));
+
+    QVector<qreal> coordinates;
+    foreach (QPointF point, simplifyPolyline(centerline, mStrokeTolerance))
+        coordinates << point.x() << point.y();
+    polyline.setAttribute(aPoints, mPrecisionPolicy.formatPoints(coordinates));
+
+    return polyline;
+}
+
+// Joins runs of stroke segment quads of the same style, each following the previous one,
+// into polylines along the segments centre line. Polylines are simplified as well.
+// Elements referenced from the iwb section (having an id) are left as they are.
+void UBCFFAdaptor::UBToCFFConverter::optimizeStrokes(QMultiMap<int, QDomElement> &svgElements)
+{
+    QMultiMap<int, QDomElement> optimized;
+    optimized.setInsertInOrder(true);
+
+    QList<QDomElement> run;
+    QVector<QPointF> runCenterline;
+    qreal runWidth = 0;
+    QString runStyle;
+    int runLayer = 0;
+
+    QMapIterator<int, QDomElement> nextSVGElement(svgElements);
+    while (nextSVGElement.hasNext() || !run.isEmpty()) {
+        QDomElement element;
+        int layer = 0;
+        if (nextSVGElement.hasNext()) {
+            nextSVGElement.next();
+            element = nextSVGElement.value();
+            layer = nextSVGElement.key();
+            mStrokeElementsIn++;
+            mStrokePointsBytesIn += element.attribute(aPoints).length();
+        }
+
+        QVector<qreal> points;
+        QPointF start, end;
+        qreal width = 0;
+        bool isSegment = !element.isNull()
+                && tIWBPolygon == element.localName()
+                && !element.hasAttribute(aID)
+                && UBCFFNumericCodec::parseNumberList(element.attribute(aPoints), points)
+                && strokeSegmentFromQuad(points, start, end, width);
+        QString style = isSegment ? strokeStyleKey(element) : QString();
+
+        bool continuesRun = isSegment && !run.isEmpty()
+                && style == runStyle
+                && qAbs(width - runWidth) <= mStrokeTolerance
+                && QLineF(runCenterline.last(), start).length() <= mStrokeTolerance;
+
+        if (continuesRun) {
+            run.append(element);
+            runCenterline.append(end);
+            continue;
+        }
+
+        // the run is over
+        if (1 == run.count()) {
+            optimized.insert(runLayer, run.first());
+            mStrokePointsBytesOut += run.first().attribute(aPoints).length();
+            mStrokeElementsOut++;
+        } else if (run.count() > 1) {
+            QDomElement polyline = createStrokePolyline(run, runCenterline, runWidth);
+            optimized.insert(runLayer, polyline);
+            mStrokePointsBytesOut += polyline.attribute(aPoints).length();
+            mStrokeElementsOut++;
+        }
+        run.clear();
+        runCenterline.clear();
+
+        if (element.isNull())
+            break;
+
+        if (isSegment) {
+            run.append(element);
+            runCenterline << start << end;
+            runWidth = width;
+            runStyle = style;
+            runLayer = layer;
+            continue;
+        }
+
+        if (tIWBPolyLine == element.localName()
+                && UBCFFNumericCodec::parseNumberList(element.attribute(aPoints), points)
+                && 0 == points.count() % 2) {
+            QVector<QPointF> polylinePoints;
+            for (int i = 0; i < points.count(); i += 2)
+                polylinePoints << QPointF(points.at(i), points.at(i + 1));
+            QVector<qreal> coordinates;
+            foreach (QPointF point, simplifyPolyline(polylinePoints, mStrokeTolerance))
+                coordinates << point.x() << point.y();
+            element.setAttribute(aPoints, mPrecisionPolicy.formatPoints(coordinates));
+        }
+
+        optimized.insert(layer, element);
+        mStrokePointsBytesOut += element.attribute(aPoints).length();
+        mStrokeElementsOut++;
+    }
+
+    svgElements = optimized;
+}
+
 bool UBCFFAdaptor::UBToCFFConverter::parseUBZImage(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList)
 {
     qDebug() << "|parsing image";
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
@@ -1569,25 +2376,23 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZVideo(const QDomElement &element, Q
 {
     qDebug() << "|parsing video";
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
-        QDomElement svgSwitchSection = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBSwitch);
+        QDomElement svgSwitchSection = createSvgElement(tIWBSwitch);
         svgSwitchSection.appendChild(svgElementPart);
 
         // if viewer cannot open that content - it must use that:
-        QDomElement svgText = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBTextArea);
+        QDomElement svgText = createSvgElement(tIWBTextArea);
         svgText.setAttribute(aX, svgElementPart.attribute(aX));
         svgText.setAttribute(aY, svgElementPart.attribute(aY));
         svgText.setAttribute(aWidth, svgElementPart.attribute(aWidth));
         svgText.setAttribute(aHeight, svgElementPart.attribute(aHeight));
         svgText.setAttribute(aTransform, svgElementPart.attribute(aTransform));
 
-        QDomText text = doc.createTextNode("Cannot Open Content");  
+        QDomText text = createTextNode("Cannot Open Content");  
         svgText.appendChild(text);
 
         svgSwitchSection.appendChild(svgText);
@@ -1617,10 +2422,8 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZAudio(const QDomElement &element, Q
     // 3 add <svg:a> section with xlink:href to audio file
     // 4 add shild to a section with id of the image
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
@@ -1629,7 +2432,6 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZAudio(const QDomElement &element, Q
         QString srcAudioImageFile(sAudioElementImage);
         QString elementId = QString(QUuid::createUuid().toString()).remove("{").remove("}");
         QString sDstAudioImageFileName = elementId+"."+fePng;
-        QString dstAudioImageFilePath = destinationPath+"/"+cfImages+"/"+sDstAudioImageFileName;
         QString dstAudioImageRelativePath = cfImages+"/"+sDstAudioImageFileName;
 
         QFile srcFile(srcAudioImageFile);
@@ -1641,12 +2443,14 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZAudio(const QDomElement &element, Q
             bRes &= dstDocFolder.mkdir(cfImages);
         
         // CFF cannot show SVG images, so we need to convert it to png.
-        if (bRes && createPngFromSvg(srcAudioImageFile, dstAudioImageFilePath, getTransformFromUBZ(element), QSize(audioImageDimention, audioImageDimention)))
+        if (bRes && createPngFromSvg(srcAudioImageFile, dstAudioImageRelativePath, getTransformFromUBZ(element), QSize(audioImageDimention, audioImageDimention)))
         {
-            QDomElement svgSwitchSection = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBSwitch);
+            mPageMediaFiles << dstAudioImageRelativePath;
+
+            QDomElement svgSwitchSection = createSvgElement(tIWBSwitch);
 
             // first we place content
-            QDomElement svgASection = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBA);
+            QDomElement svgASection = createSvgElement(tIWBA);
             svgASection.setAttribute(aSVGHref, svgElementPart.attribute(aSVGHref));
         
             svgElementPart.setTagName(tIWBImage);
@@ -1659,14 +2463,14 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZAudio(const QDomElement &element, Q
             svgSwitchSection.appendChild(svgASection);
 
             // if viewer cannot open that content - it must use that:
-            QDomElement svgText = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + tIWBTextArea);
+            QDomElement svgText = createSvgElement(tIWBTextArea);
             svgText.setAttribute(aX, svgElementPart.attribute(aX));
             svgText.setAttribute(aY, svgElementPart.attribute(aY));
             svgText.setAttribute(aWidth, svgElementPart.attribute(aWidth));
             svgText.setAttribute(aHeight, svgElementPart.attribute(aHeight));
             svgText.setAttribute(aTransform, svgElementPart.attribute(aTransform));
 
-            QDomText text = doc.createTextNode("Cannot Open Content");  
+            QDomText text = createTextNode("Cannot Open Content");  
             svgText.appendChild(text);
 
             svgSwitchSection.appendChild(svgText);
@@ -1696,10 +2500,8 @@ bool UBCFFAdaptor::UBToCFFConverter::parseForeignObject(const QDomElement &eleme
 
     qDebug() << "|parsing foreign object";
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
@@ -1720,26 +2522,15 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZText(const QDomElement &element, QM
 {
     qDebug() << "|parsing text";
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
     
     if (element.hasChildNodes())
     {
-        QDomDocument htmlDoc;
-        htmlDoc.setContent(findTextNode(element).nodeValue());
-        QDomNode bodyNode = findNodeByTagName(htmlDoc.firstChildElement(), "body");
-
-        setCFFTextFromHTMLTextNode(bodyNode.toElement(), svgElementPart);
+        QString commonParams = setCFFTextFromHTML(findTextNode(element).nodeValue(), svgElementPart);
 
         if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
         {
-            QString commonParams;
-            for (int i = 0; i < bodyNode.attributes().count(); i++)
-            {
-                commonParams += " " + bodyNode.attributes().item(i).nodeValue();
-            }
             commonParams.remove(" ");
             commonParams.remove("'");
 
@@ -1774,15 +2565,11 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZPolygon(const QDomElement &element,
 {
     qDebug() << "||parsing polygon";
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
-        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));
-
         if (0 < iwbElementPart.attributes().count())
         {   
             QString id = QUuid::createUuid().toString().remove("{").remove("}");
@@ -1791,6 +2578,8 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZPolygon(const QDomElement &element,
 
             addIWBElementToResultModel(iwbElementPart);
         }
+
+        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));
         return true;
     }
     else
@@ -1807,15 +2596,11 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZPolyline(const QDomElement &element
     qDebug() << "||parsing polyline";
     QDomElement resElement;
 
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
-        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));
-
         if (0 < iwbElementPart.attributes().count())
         {
             QString id = QUuid::createUuid().toString().remove("{").remove("}");
@@ -1824,6 +2609,8 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZPolyline(const QDomElement &element
 
             addIWBElementToResultModel(iwbElementPart);
         }
+
+        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));
         return true;
     }
     else
@@ -1839,15 +2626,11 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZLine(const QDomElement &element, QM
 {   
     qDebug() << "||parsing line";
     QDomElement resElement;
-    QDomDocument doc;
-
-    QDomElement svgElementPart = doc.createElementNS(svgIWBNS,svgIWBNSPrefix + ":" + getElementTypeFromUBZ(element));
-    QDomElement iwbElementPart = doc.createElementNS(iwbNS,iwbNsPrefix + ":" + tElement);
+    QDomElement svgElementPart = createSvgElement(getElementTypeFromUBZ(element));
+    QDomElement iwbElementPart = createIwbElement();
 
     if (setCommonAttributesFromUBZ(element, iwbElementPart, svgElementPart))
     {
-        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));
-
         if (0 < iwbElementPart.attributes().count())
         {
             QString id = QUuid::createUuid().toString().remove("{").remove("}");
@@ -1855,7 +2638,9 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZLine(const QDomElement &element, QM
             iwbElementPart.setAttribute(aRef, id);
 
             addIWBElementToResultModel(iwbElementPart);
-        }      
+        }
+
+        addSVGElementToResultModel(svgElementPart, dstSvgList, getElementLayer(element));      
     }
     else
     {
@@ -1866,20 +2651,35 @@ bool UBCFFAdaptor::UBToCFFConverter::parseUBZLine(const QDomElement &element, QM
     return true;
 }
 
+// Output nodes are created right in mDocumentToWrite, the document that owns them
+// in the end, instead of a throwaway QDomDocument per parsed element.
+QDomElement UBCFFAdaptor::UBToCFFConverter::createSvgElement(const QString &tagName) const
+{
+    return mDocumentToWrite->createElementNS(svgIWBNS, svgIWBNSPrefix + ":" + tagName);
+}
+
+QDomElement UBCFFAdaptor::UBToCFFConverter::createIwbElement() const
+{
+    return mDocumentToWrite->createElementNS(iwbNS, iwbNsPrefix + ":" + tElement);
+}
+
+QDomText UBCFFAdaptor::UBToCFFConverter::createTextNode(const QString &text) const
+{
+    return mDocumentToWrite->createTextNode(text);
+}
+
+// The result model takes the finished subtree itself, it is not copied. Elements are
+// created in mDocumentToWrite already, so they only have to be attached to their parents.
 void UBCFFAdaptor::UBToCFFConverter::addSVGElementToResultModel(const QDomElement &element, QMultiMap<int, QDomElement> &dstList, int layer)
 {
     int elementLayer = (DEFAULT_LAYER == layer) ? DEFAULT_LAYER : layer;
     dstList.setInsertInOrder(true);
-    QDomElement rootElement = element.cloneNode(true).toElement();
-    mDocumentToWrite->firstChildElement().appendChild(rootElement);
-    dstList.insert(elementLayer, rootElement);
+    dstList.insert(elementLayer, element);
 }
 
 void UBCFFAdaptor::UBToCFFConverter::addIWBElementToResultModel(const QDomElement &element)
 {
-    QDomElement rootElement = element.cloneNode(true).toElement();
-    mDocumentToWrite->firstChildElement().appendChild(rootElement);
-    mExtendedElements.append(rootElement);
+    mExtendedElements.append(element);
 }
 
 UBCFFAdaptor::UBToCFFConverter::~UBToCFFConverter()
@@ -1890,6 +2690,8 @@ UBCFFAdaptor::UBToCFFConverter::~UBToCFFConverter()
         delete mIWBContentWriter;
     if (mDocumentToWrite)
         delete mDocumentToWrite;
+    if (mOutputManifest)
+        delete mOutputManifest;
 }
 bool UBCFFAdaptor::UBToCFFConverter::isValid() const
 {
@@ -1917,10 +2719,6 @@ QString UBCFFAdaptor::UBToCFFConverter::digitFileFormat(int digit) const
 {
     return QString("%1").arg(digit, 3, 10, QLatin1Char('0'));
 }
-QString UBCFFAdaptor::UBToCFFConverter::contentIWBFileName() const
-{
-    return destinationPath + "/" + fIWBContent;
-}
 
 //setting SVG dimenitons
 QSize UBCFFAdaptor::UBToCFFConverter::getSVGDimentions(const QString &element)
@@ -1979,10 +2777,37 @@ QString UBCFFAdaptor::UBToCFFConverter::rectToIWBAttr(const QRect &rect) const
 {
     if (rect.isNull()) return QString();
 
-    return QString("%1 %2 %3 %4").arg(rect.topLeft().x())
-                                 .arg(rect.topLeft().y())
-                                 .arg(rect.width())
-                                 .arg(rect.height());
+    QVector<qreal> dimensions;
+    dimensions << rect.topLeft().x() << rect.topLeft().y() << rect.width() << rect.height();
+    return UBCFFNumericCodec::formatNumberList(dimensions);
+}
+
+// points are parsed and written again, a list that can't be parsed is kept as is
+QString UBCFFAdaptor::UBToCFFConverter::convertPoints(const QString &ubzPoints) const
+{
+    QVector<qreal> coordinates;
+    if (!UBCFFNumericCodec::parseNumberList(ubzPoints, coordinates))
+        return ubzPoints;
+
+    return mPrecisionPolicy.formatPoints(coordinates);
+}
+
+// numeric geometry attributes copied from ubz get the output precision, others are kept as is
+QString UBCFFAdaptor::UBToCFFConverter::convertGeometryValue(const QString &attributeName, const QString &ubzValue) const
+{
+    UBCFFPrecisionPolicy::ValueClass valueClass;
+    if (aX == attributeName || aY == attributeName
+            || aX+"1" == attributeName || aY+"1" == attributeName
+            || aX+"2" == attributeName || aY+"2" == attributeName)
+        valueClass = UBCFFPrecisionPolicy::Coordinate;
+    else if (aWidth == attributeName || aHeight == attributeName || aStrokeWidth == attributeName)
+        valueClass = UBCFFPrecisionPolicy::Size;
+    else
+        return ubzValue;
+
+    bool ok = false;
+    qreal value = UBCFFNumericCodec::parseNumber(ubzValue, &ok);
+    return ok ? mPrecisionPolicy.format(value, valueClass) : ubzValue;
 }
 
 UBCFFAdaptor::UBToUBZConverter::UBToUBZConverter()
@@ -5,27 +5,99 @@
 
 #include <QtCore>
 
+#include "UBCFFNumericCodec.h"
+#include "UBCFFOutputManifest.h"
+
 class QTransform;
 class QDomDocument;
 class QDomElement;
 class QDomNode;
+class QDomText;
+class QuaZip;
 class QuaZipFile;
+struct QuaZipNewInfo;
+class UBCFFPageCache;
+class UBCFFDocumentCache;
+class UBCFFConversionJob;
+
+// Where the time of the last conversion went, in nanoseconds, and the size of its content.xml.
+// Rendering svg images to png happens while parsing but is counted apart from it, parsing
+// includes deflating content.xml. All zero if the document was taken from the document cache
+struct UBCFFConversionProfile
+{
+    UBCFFConversionProfile() : unzipTime(0), parseTime(0), rasterizeTime(0), packTime(0), contentSize(0) {}
+
+    qint64 unzipTime;
+    qint64 parseTime;
+    qint64 rasterizeTime;
+    qint64 packTime;
+    qint64 contentSize;
+};
 
 class UBCFFADAPTORSHARED_EXPORT UBCFFAdaptor {
     class UBToCFFConverter;
+    friend class UBCFFConversionJob;
+
+    static const qint64 DEFAULT_DOCUMENT_CACHE_SIZE = Q_INT64_C(1024)*1024*1024;
 
 public:
     UBCFFAdaptor();
     ~UBCFFAdaptor();
 
     bool convertUBZToIWB(const QString &from, const QString &to);
+    // streams the iwb to "to" as it is produced, the device may be sequential (a pipe, a socket, stdout).
+    // Incremental conversion needs an output file and is not used
+    bool convertUBZToIWB(const QString &from, QIODevice *to);
+    // the ubz is read from a device, a sequential one is read to the end into memory first
+    bool convertUBZToIWB(QIODevice *from, QIODevice *to);
+    // in memory conversion, meant for small documents: the whole iwb is built in "to"
+    bool convertUBZToIWB(const QByteArray &from, QByteArray *to);
     bool deleteDir(const QString& pDirPath) const;
 
+    // content.xml without indentation, noticeably smaller for big documents
+    void setCompactOutput(bool compact) {mCompactOutput = compact;}
+    bool compactOutput() const {return mCompactOutput;}
+
+    // keeps converted pages in <output>.cffcache and converts only changed pages on the next run
+    void setIncremental(bool incremental) {mIncremental = incremental;}
+    bool incremental() const {return mIncremental;}
+
+    // merges pen strokes stored as chains of polygons into polylines simplified within tolerance (in px)
+    void setStrokeOptimization(bool optimize, qreal tolerance = 0.5) {mOptimizeStrokes = optimize; mStrokeTolerance = tolerance;}
+    bool strokeOptimization() const {return mOptimizeStrokes;}
+
+    // decimals of the output geometry, 3 for all the values by default
+    void setPrecisionPolicy(const UBCFFPrecisionPolicy &policy) {mPrecisionPolicy = policy;}
+    UBCFFPrecisionPolicy precisionPolicy() const {return mPrecisionPolicy;}
+
+    // folder the temporary workspaces are created in, the system temp folder by default (tmpfs is faster)
+    void setTmpRoot(const QString &tmpRoot) {mTmpRoot = tmpRoot;}
+    QString tmpRoot() const {return mTmpRoot;}
+    // workspaces of the conversion in progress, only valid in the converting thread
+    QStringList workspaces() const {return tmpDirs;}
+
+    // identical ubz files converted with the same options are taken from cacheDir, empty cacheDir disables it
+    void setDocumentCache(const QString &cacheDir, qint64 maxSize = DEFAULT_DOCUMENT_CACHE_SIZE);
+    QString documentCacheDir() const {return mDocumentCacheDir;}
+
+    UBCFFConversionProfile lastProfile() const {return mProfile;}
+
 private:
-    QString uncompressZip(const QString &zipFile);
-    bool compressZip(const QString &source, const QString &destination);
-    bool compressDir(const QString &dirName, const QString &parentDir, QuaZipFile *outZip);
-    bool compressFile(const QString &fileName, const QString &parentDir, QuaZipFile *outZip);
+    bool convert(const QString &from, QIODevice *fromDevice, const QString &to, QIODevice *toDevice);
+    QString uncompressZip(const QString &zipFile, QIODevice *zipDevice, QStringList *pageFileNames = NULL);
+    bool createZip(QuaZip *zip);
+    bool compressZip(const UBCFFOutputManifest *manifest, QuaZip *zip);
+    bool storeFile(const QString &fileName, const UBCFFOutputManifest::Entry &entry, QuaZipFile *outZip);
+    bool compressFile(const QString &fileName, const QString &parentDir, QuaZipFile *outZip, int level = -1); // zlib level, -1 is the default
+    bool compressFileParallel(QFile &sourceFile, const QuaZipNewInfo &info, QuaZipFile *outZip);
+    bool compressReusedFiles(const QStringList &files, UBCFFPageCache *pageCache, QuaZip *zip);
+    bool copyZipEntry(QuaZip *fromZip, const QString &entryName, QuaZipFile *outZip, bool *entryStarted);
+
+    QString documentCacheOptions() const;
+
+    void setJob(UBCFFConversionJob *job) {mJob = job;}
+    bool isCanceled() const;
+    void reportBytes(qint64 bytes);
 
     QString createNewTmpDir();
     bool freeDir(const QString &dir);
@@ -33,6 +105,16 @@ private:
 
 private:
     QStringList tmpDirs;
+    QString mTmpRoot;
+    bool mCompactOutput;
+    bool mIncremental;
+    bool mOptimizeStrokes;
+    qreal mStrokeTolerance;
+    UBCFFPrecisionPolicy mPrecisionPolicy;
+    QString mDocumentCacheDir;
+    qint64 mDocumentCacheSize;
+    UBCFFConversionJob *mJob; //asynchronous job running the conversion, NULL for blocking calls
+    UBCFFConversionProfile mProfile;
 
 private:
 
@@ -45,15 +127,30 @@ private:
         ~UBToCFFConverter();
         bool isValid() const;
         QString lastErrStr() const {return errorStr;}
-        bool parse();
+        bool parse(QIODevice *contentDevice);
+        void setCompactOutput(bool compact);
+        void setStrokeOptimization(bool optimize, qreal tolerance) {mOptimizeStrokes = optimize; mStrokeTolerance = tolerance;}
+        void setPrecisionPolicy(const UBCFFPrecisionPolicy &policy) {mPrecisionPolicy = policy;}
+        void setPageFileNames(const QStringList &pageFileNames) {mPageFileNames = pageFileNames;}
+        void setPageCache(UBCFFPageCache *pageCache) {mPageCache = pageCache;}
+        QStringList reusedMediaFiles() const {return mReusedMediaFiles;}
+        const UBCFFOutputManifest *outputManifest() const {return mOutputManifest;}
+        qint64 rasterizeTime() const {return mRasterizeTime;}
+        void setJob(UBCFFConversionJob *job) {mJob = job;}
 
     private:
         void fillNamespaces();
 
         bool parseMetadata();
         bool parseContent();
+        QStringList getPageFileNames();
+        QStringList sortPageFileNames(const QStringList &fileNames);
+        int getPageNumberFromFileName(const QString &fileName);
         QDomElement parsePageset(const QStringList &pageFileNames);
         QDomElement parsePage(const QString &pageFileName);
+        QDomElement restorePageFromCache(const QString &pageKey);
+        QString pageCacheContext() const;
+        bool isCanceled() const;
         QDomElement parseSvgPageSection(const QDomElement &element);
         void writeQDomElementToXML(const QDomNode &node);
         bool writeExtendedIwbSection();
@@ -61,7 +158,7 @@ private:
 
         bool createBackground(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);
         QString createBackgroundImage(const QDomElement &element, QSize size);
-        bool createPngFromSvg(QString &svgPath, QString &dstPath,  QTransform transformation, QSize size = QSize());
+        bool createPngFromSvg(QString &svgPath, const QString &dstPath,  QTransform transformation, QSize size = QSize());
 
         bool parseSVGGGroup(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);
         bool parseUBZImage(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);
@@ -73,6 +170,12 @@ private:
         bool parseUBZPolygon(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);
         bool parseUBZPolyline(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);
         bool parseUBZLine(const QDomElement &element, QMultiMap<int, QDomElement> &dstSvgList);       
+        void optimizeStrokes(QMultiMap<int, QDomElement> &svgElements);
+        QDomElement createStrokePolyline(const QList<QDomElement> &segments, const QVector<QPointF> &centerline, qreal width);
+        QString strokeStyleKey(const QDomElement &element) const;
+        QDomElement createSvgElement(const QString &tagName) const;
+        QDomElement createIwbElement() const;
+        QDomText createTextNode(const QString &text) const;
         void addSVGElementToResultModel(const QDomElement &element, QMultiMap<int, QDomElement> &dstList, int layer = DEFAULT_LAYER);
         void addIWBElementToResultModel(const QDomElement &element);
 
@@ -99,7 +202,8 @@ private:
         void setCoordinatesFromUBZ(const QDomElement &ubzElement, QDomElement &iwbElement);
         bool setContentFromUBZ(const QDomElement &ubzElement, QDomElement &svgElement);
         void setCFFTextFromUBZ(const QDomElement &ubzElement, QDomElement &iwbElement, QDomElement &svgElement);
-        void setCFFTextFromHTMLTextNode(const QDomElement htmlTextNode, QDomElement &iwbElement);
+        QString setCFFTextFromHTML(const QString &html, QDomElement &svgTextElement);
+        const QList<QPair<QString, QString> > &tspanStyleAttributes(const QString &style);
         QString ubzAttrNameToCFFAttrName(QString cffAttrName);
         QString ubzAttrValueToCFFAttrName(QString cffAttrValue);
 
@@ -108,20 +212,35 @@ private:
         void setViewBox(QRect viewbox);
 
         QDomNode findTextNode(const QDomNode &node);
-        QDomNode findNodeByTagName(const QDomNode &node, QString tagName);
 
         QSize getSVGDimentions(const QString &element);
 
         inline QRect getViewboxRect(const QString &element) const;
         inline QString rectToIWBAttr(const QRect &rect) const;
+        QString convertPoints(const QString &ubzPoints) const;
+        QString convertGeometryValue(const QString &attributeName, const QString &ubzValue) const;
         inline QString digitFileFormat(int num) const;
         inline bool strToBool(const QString &in) const {return in == "true";}
-        QString contentIWBFileName() const;
 
     private:
         QMap<QString, QString> iwbSVGItemsAttributes;
         QDomDocument *mDataModel; //model for reading indata
         QXmlStreamWriter *mIWBContentWriter; //stream to write outdata
+        QStringList mPageFileNames; //page files found in the source archive, if any
+        int mPageCount; //page count from metadata, 0 if not specified
+        UBCFFConversionJob *mJob; //to check for cancellation and report progress, may be NULL
+        bool mOptimizeStrokes;
+        qreal mStrokeTolerance;
+        int mStrokeElementsIn, mStrokeElementsOut; //stroke optimization statistics
+        int mStrokePointsBytesIn, mStrokePointsBytesOut;
+        UBCFFPrecisionPolicy mPrecisionPolicy;
+        QHash<QString, QList<QPair<QString, QString> > > mTspanStyleCache; //tspan attributes by html style string
+        UBCFFPageCache *mPageCache; //converted pages of the previous run, NULL if not incremental
+        QStringList mPageMediaFiles; //media files written for the current page, relative to destinationPath
+        QStringList mReusedMediaFiles; //media files of the pages taken from mPageCache
+        UBCFFOutputManifest *mOutputManifest; //files written to destinationPath, the archive is packed from it
+        qint64 mRasterizeTime; //nanoseconds spent rendering svg images to png
+        QRect mPageViewbox; //viewbox of the current page
         QSize mSVGSize; //svg page size
         QRect mViewbox; //Main viewbox parameter for CFF
         QString sourcePath; // dir with unpacked source data (ubz)
@@ -13,6 +13,8 @@ const QString fMetadata = "metadata.rdf";
 const QString fIWBContent = "content.xml";
 const QString fIWBBackground = "background.png";
 const QString sAudioElementImage = ":images/soundOn.svg";
+const QString fPageCacheManifest = "manifest.xml";
+const QString fPageCachePreviousArchive = "previous.iwb";
 
 // Constant messages;
 const QString noErrorMsg = "NoError";
@@ -22,6 +24,7 @@ const QString tDescription = "Description";
 const QString tIWBRoot = "iwb";
 const QString tIWBMeta = "meta";
 const QString tUBZSize = "size";
+const QString tUBZPageCount = "pageCount";
 const QString tSvg = "svg";
 const QString tIWBPage = "page";
 const QString tIWBPageSet = "pageset";
@@ -53,6 +56,8 @@ const QString tIWBRect = "rect";
 const QString tIWBLine = "line";
 const QString tIWBTbreak = "tbreak";
 const QString tIWBTspan = "tspan";
+const QString tPageCacheRoot = "cffcache";
+const QString tPageCacheMedia = "media";
 
 // Attributes names
 const QString aIWBVersion = "version";
@@ -83,6 +88,10 @@ const QString aWidth = "width";
 const QString aHeight = "height";
 const QString aStroke = "stroke";
 const QString aStrokeWidth = "stroke-width";
+const QString aStrokeOpacity = "stroke-opacity";
+const QString aStrokeLineCap = "stroke-linecap";
+const QString aStrokeLineJoin = "stroke-linejoin";
+const QString aFillOpacity = "fill-opacity";
 const QString aPoints = "points";
 const QString aZLayer = "z-value";
 const QString aLayer = "layer";
@@ -90,6 +99,7 @@ const QString aTransform = "transform";
 const QString aLocked = "locked";
 const QString aIWBName = "name";
 const QString aIWBContent = "content";
+const QString aPageCacheKey = "key";
 
 
 // Attribute values
@@ -97,6 +107,10 @@ const QString avIWBVersionNo = "1.0";
 const QString avUBZText = "text";
 const QString avFalse = "false";
 const QString avTrue = "true";
+const QString avNone = "none";
+const QString avRound = "round";
+const QString avPageCacheVersion = "2"; // change it whenever the conversion result for a page changes
+const QString avDocumentCacheVersion = "2"; // change it whenever the conversion result for a document changes
 
 // Namespaces and prefixes
 const QString svgRequiredExtensionPrefix = "http://www.imsglobal.org/iwb/";
@@ -136,14 +150,33 @@ const QString cfVideos = "video";
 const QString cfAudios = "audio";
 const QString cfFlash = "flash";
 
+//incremental conversion cache, placed next to the output file
+const QString sPageCacheDirSuffix = ".cffcache";
+const QString cfPageCachePages = "pages";
+const QString cfPageCacheMedia = "media";
+
 //known file extentions
 const QString feSvg = "svg";
 const QString feWgt = "wgt";
 const QString fePng = "png";
+const QString feIwb = "iwb";
+const QString feDocumentCacheTmp = "tmp";
 
 const int iCrossSize = 32;
 const int iCrossWidth = 1;
 
+// Files bigger than that are deflated by several threads in blocks, pigz style
+const qint64 iParallelDeflateThreshold = 8*1024*1024;
+const int iParallelDeflateBlockSize = 1024*1024;
+const int iDeflateDictionarySize = 32*1024; // deflate window, primes each next block
+const qint64 iZipCopyChunkSize = 1024*1024; // archive entries are streamed, media may be several GB
+
+const int iDocumentCacheTmpFileLifetime = 60*60; // seconds, unpublished entries older than that are abandoned
+
+// Temporary workspaces of the conversions, a random suffix follows the prefix
+const QString sTmpDirPrefix = "CFF_adaptor_filedata_store.";
+const int iTmpDirAttempts = 16;
+
 // Image formats supported by CFF exclude wgt. Wgt is Sankore widget, which is considered as a .png preview.
 const QString iwbElementImage(" \
 wgt, \
@@ -174,6 +207,18 @@ wav \
 const QString cffSupportedFileFormats(iwbElementImage + iwbElementVideo + iwbElementAudio);
 const QString ubzFormatsToConvert("svg");
 
+// Formats compressed already, packed into the archive without deflating them again
+const QString cffStoredFileFormats(" \
+png, \
+jpg, \
+jpeg, \
+gif, \
+mpg, \
+mpeg, \
+swf, \
+mp3 \
+");
+
 
 const QString iwbSVGImageAttributes(" \
 id, \
@@ -288,11 +333,13 @@ transform \
 const QString iwbSVGPolyLineAttributes(" \
 id, \
 points, \
+fill, \
 stroke, \
 stroke-width, \
 stroke-dasharray, \
 stroke-opacity, \
 stroke-linecap, \
+stroke-linejoin, \
 transform \
 ");
 
@@ -0,0 +1,91 @@
+#include "UBCFFConversionJob.h"
+
+UBCFFConversionJob::UBCFFConversionJob(const QString &from, const QString &to, QObject *parent)
+    : QObject(parent)
+    , mFrom(from)
+    , mTo(to)
+    , mCanceled(0)
+    , mBytesPacked(0)
+    , mStarted(false)
+    , mFinished(false)
+    , mResult(false)
+{
+    setAutoDelete(false);
+    mAdaptor.setJob(this);
+}
+
+UBCFFConversionJob::~UBCFFConversionJob()
+{
+    cancel();
+    waitForFinished();
+}
+
+void UBCFFConversionJob::start(QThreadPool *threadPool)
+{
+    QMutexLocker locker(&mStateMutex);
+    if (mStarted)
+        return;
+    mStarted = true;
+    threadPool->start(this);
+}
+
+// Blocks until the conversion is over, returns its result. Doesn't block if the job was not started
+bool UBCFFConversionJob::waitForFinished()
+{
+    QMutexLocker locker(&mStateMutex);
+    while (mStarted && !mFinished)
+        mFinishedCondition.wait(&mStateMutex);
+
+    return mResult;
+}
+
+bool UBCFFConversionJob::isCanceled() const
+{
+    return mCanceled != 0;
+}
+
+bool UBCFFConversionJob::isFinished() const
+{
+    QMutexLocker locker(&mStateMutex);
+    return mFinished;
+}
+
+bool UBCFFConversionJob::result() const
+{
+    QMutexLocker locker(&mStateMutex);
+    return mResult;
+}
+
+void UBCFFConversionJob::reportPages(int pagesDone, int pageCount)
+{
+    emit pagesProgress(pagesDone, pageCount);
+}
+
+void UBCFFConversionJob::reportBytes(qint64 bytes)
+{
+    mBytesPacked += bytes;
+    emit bytesProgress(mBytesPacked);
+}
+
+void UBCFFConversionJob::cancel()
+{
+    mCanceled.fetchAndStoreOrdered(1);
+}
+
+void UBCFFConversionJob::run()
+{
+    bool result = !isCanceled() && mAdaptor.convertUBZToIWB(mFrom, mTo);
+    if (isCanceled())
+        qDebug() << "conversion of" << mFrom << "was canceled";
+
+    mStateMutex.lock();
+    mResult = result;
+    mStateMutex.unlock();
+
+    emit finished(result);
+
+    // the job may be deleted as soon as waitForFinished() returns, don't touch it after that
+    QMutexLocker locker(&mStateMutex);
+    mFinished = true;
+    mFinishedCondition.wakeAll();
+}
@@ -0,0 +1,63 @@
+#ifndef UBCFFCONVERSIONJOB_H
+#define UBCFFCONVERSIONJOB_H
+
+#include "UBCFFAdaptor_global.h"
+#include "UBCFFAdaptor.h"
+
+#include <QtCore>
+
+// Asynchronous ubz to iwb conversion run on a thread pool.
+// Set the conversion options with adaptor(), connect to the signals and start() the job.
+// Signals are emitted from the worker thread, queued connections deliver them to the
+// receiver's thread. cancel() is checked between pages, archive entries and raster jobs,
+// a canceled conversion removes its temporary data and the partial output before finishing.
+class UBCFFADAPTORSHARED_EXPORT UBCFFConversionJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    UBCFFConversionJob(const QString &from, const QString &to, QObject *parent = 0);
+    ~UBCFFConversionJob();
+
+    UBCFFAdaptor *adaptor() {return &mAdaptor;}
+    QString from() const {return mFrom;}
+    QString to() const {return mTo;}
+
+    void start(QThreadPool *threadPool = QThreadPool::globalInstance());
+    bool waitForFinished();
+
+    bool isCanceled() const;
+    bool isFinished() const;
+    bool result() const;
+
+    // progress reported by the conversion, worker thread only
+    void reportPages(int pagesDone, int pageCount);
+    void reportBytes(qint64 bytes);
+
+public slots:
+    void cancel();
+
+signals:
+    void pagesProgress(int pagesDone, int pageCount);
+    void bytesProgress(qint64 bytesPacked);
+    void finished(bool result);
+
+protected:
+    void run();
+
+private:
+    QString mFrom;
+    QString mTo;
+    UBCFFAdaptor mAdaptor;
+
+    QAtomicInt mCanceled;
+    qint64 mBytesPacked;
+
+    mutable QMutex mStateMutex;
+    QWaitCondition mFinishedCondition;
+    bool mStarted;
+    bool mFinished;
+    bool mResult;
+};
+
+#endif // UBCFFCONVERSIONJOB_H
@@ -0,0 +1,186 @@
+#include "UBCFFDocumentCache.h"
+
+#include "UBCFFConstants.h"
+
+#ifdef Q_OS_WIN
+#include <sys/utime.h>
+#else
+#include <stdio.h>
+#include <utime.h>
+#endif
+
+UBCFFDocumentCache::UBCFFDocumentCache(const QString &cacheDir, qint64 maxSize)
+    : mCacheDir(cacheDir)
+    , mMaxSize(maxSize)
+{}
+
+QString UBCFFDocumentCache::documentKey(const QString &sourceFile, const QString &options) const
+{
+    QFile file(sourceFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    return documentKey(&file, options);
+}
+
+// Hashes the whole device and leaves it where it was, a sequential device can't be rewound and gets no key
+QString UBCFFDocumentCache::documentKey(QIODevice *source, const QString &options) const
+{
+    if (source->isSequential())
+        return QString();
+
+    bool opened = !source->isOpen();
+    if (opened && !source->open(QIODevice::ReadOnly))
+        return QString();
+    qint64 pos = source->pos();
+    source->seek(0);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(avDocumentCacheVersion.toUtf8());
+    hash.addData(avIWBVersionNo.toUtf8());
+    hash.addData(options.toUtf8());
+    while (!source->atEnd())
+        hash.addData(source->read(64*1024));
+
+    source->seek(pos);
+    if (opened)
+        source->close();
+
+    return QString(hash.result().toHex());
+}
+
+// Copies the cached document for the key to "to". The copy goes to a temporary file next
+// to "to" first, an existing "to" is only replaced once the copy is complete.
+// The output is never linked to the entry: rewriting it in place would change the entry
+bool UBCFFDocumentCache::fetch(const QString &key, const QString &to)
+{
+    if (key.isEmpty())
+        return false;
+
+    QString entryFile = entryFilePath(key);
+    if (!QFile::exists(entryFile))
+        return false;
+
+    QString tmpFile = uniqueTmpFilePath(to);
+    if (!QFile::copy(entryFile, tmpFile) || !replaceFile(tmpFile, to)) {
+        qDebug() << "can't take" << entryFile << "from the document cache";
+        QFile::remove(tmpFile);
+        return false;
+    }
+
+    touch(entryFile);
+    return true;
+}
+
+// Writes the cached document for the key to a device, which may be sequential.
+// "written" tells if anything reached the device, a failed fetch can't be undone then
+bool UBCFFDocumentCache::fetch(const QString &key, QIODevice *to, bool *written)
+{
+    if (written)
+        *written = false;
+    if (key.isEmpty())
+        return false;
+
+    QString entryFile = entryFilePath(key);
+    QFile entry(entryFile);
+    if (!entry.open(QIODevice::ReadOnly))
+        return false;
+
+    while (!entry.atEnd()) {
+        QByteArray data = entry.read(64*1024);
+        qint64 bytes = data.isEmpty() ? 0 : to->write(data);
+        if (written && bytes > 0)
+            *written = true;
+        if (data.isEmpty() || bytes != data.size()) {
+            qDebug() << "can't take" << entryFile << "from the document cache";
+            return false;
+        }
+    }
+
+    touch(entryFile);
+    return true;
+}
+
+bool UBCFFDocumentCache::store(const QString &key, const QString &from)
+{
+    if (key.isEmpty())
+        return false;
+
+    if (!QDir().mkpath(mCacheDir)) {
+        qDebug() << "can't create document cache folder" << mCacheDir;
+        return false;
+    }
+
+    QString entryFile = entryFilePath(key);
+    if (QFile::exists(entryFile)) {
+        touch(entryFile);
+        return true;
+    }
+
+    // a copy, the entry must not change when "from" is rewritten later
+    QString tmpFile = uniqueTmpFilePath(entryFile);
+    if (!QFile::copy(from, tmpFile)) {
+        qDebug() << "can't put" << from << "to the document cache";
+        QFile::remove(tmpFile);
+        return false;
+    }
+
+    // another process could have published the same document meanwhile, it is the same file then
+    if (!QFile::rename(tmpFile, entryFile))
+        QFile::remove(tmpFile);
+
+    evict();
+    return true;
+}
+
+QString UBCFFDocumentCache::entryFilePath(const QString &key) const
+{
+    return mCacheDir + "/" + key + "." + feIwb;
+}
+
+QString UBCFFDocumentCache::uniqueTmpFilePath(const QString &filePath) const
+{
+    return QString("%1.%2.%3").arg(filePath)
+                              .arg(QString(QUuid::createUuid().toString()).remove("{").remove("}"))
+                              .arg(feDocumentCacheTmp);
+}
+
+// Moves "from" over "to", in one step where the platform allows it
+bool UBCFFDocumentCache::replaceFile(const QString &from, const QString &to) const
+{
+#ifndef Q_OS_WIN
+    return 0 == ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData());
+#else
+    QFile::remove(to);
+    return QFile::rename(from, to);
+#endif
+}
+
+// last modification time of an entry is its last use
+void UBCFFDocumentCache::touch(const QString &filePath) const
+{
+#ifdef Q_OS_WIN
+    _wutime((const wchar_t*)filePath.utf16(), NULL);
+#else
+    ::utime(QFile::encodeName(filePath).constData(), NULL);
+#endif
+}
+
+void UBCFFDocumentCache::evict()
+{
+    QDir cacheDir(mCacheDir);
+
+    // leftovers of the writers killed before publishing their entries
+    QFileInfoList tmpFiles = cacheDir.entryInfoList(QStringList() << "*." + feDocumentCacheTmp, QDir::Files);
+    foreach (QFileInfo tmpFile, tmpFiles)
+        if (tmpFile.lastModified().secsTo(QDateTime::currentDateTime()) > iDocumentCacheTmpFileLifetime)
+            QFile::remove(tmpFile.absoluteFilePath());
+
+    qint64 cacheSize = 0;
+    QFileInfoList entries = cacheDir.entryInfoList(QStringList() << "*." + feIwb, QDir::Files, QDir::Time);
+    foreach (QFileInfo entry, entries) {
+        cacheSize += entry.size();
+        if (cacheSize > mMaxSize)
+            QFile::remove(entry.absoluteFilePath());
+    }
+}
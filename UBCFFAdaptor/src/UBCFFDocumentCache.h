@@ -0,0 +1,37 @@
+#ifndef UBCFFDOCUMENTCACHE_H
+#define UBCFFDOCUMENTCACHE_H
+
+#include <QtCore>
+
+// Content addressed cache of converted documents, shared by all the conversions
+// (and processes) pointed to the same folder. An entry is the resulting iwb file
+// named by the hash of the source ubz and the conversion options.
+// Entries are never modified once published: writers put a new entry under a unique
+// temporary name and rename it into place, so readers never see a partial file and
+// no lock is needed. Entries are copied to and from the outputs, never linked, so an
+// output rewritten in place can't change an entry. Least recently used entries are
+// evicted to keep the cache size.
+class UBCFFDocumentCache
+{
+public:
+    UBCFFDocumentCache(const QString &cacheDir, qint64 maxSize);
+
+    QString documentKey(const QString &sourceFile, const QString &options) const;
+    QString documentKey(QIODevice *source, const QString &options) const;
+
+    bool fetch(const QString &key, const QString &to);
+    bool fetch(const QString &key, QIODevice *to, bool *written = NULL);
+    bool store(const QString &key, const QString &from);
+
+private:
+    QString entryFilePath(const QString &key) const;
+    QString uniqueTmpFilePath(const QString &filePath) const;
+    bool replaceFile(const QString &from, const QString &to) const;
+    void touch(const QString &filePath) const;
+    void evict();
+
+    QString mCacheDir;
+    qint64 mMaxSize;
+};
+
+#endif // UBCFFDOCUMENTCACHE_H
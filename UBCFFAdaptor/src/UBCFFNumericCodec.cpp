@@ -0,0 +1,290 @@
+#include "UBCFFNumericCodec.h"
+
+#include <math.h>
+
+// powers of ten exactly representable by a double
+static const double exactPowersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int maxExactPowerOf10 = 22;
+static const int maxExactMantissaDigits = 15; // any 15 digits integer is exact in a double
+static const int maxMantissaDigits = 19; // still fits quint64
+static const int maxFixedDecimals = 9;
+
+static inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isSeparator(ushort c)
+{
+    return ' ' == c || ',' == c || '\t' == c || '\n' == c || '\r' == c;
+}
+
+// Returns the position after the number, or begin if there is no number there
+const ushort *UBCFFNumericCodec::parseNumber(const ushort *begin, const ushort *end, qreal &value)
+{
+    const ushort *p = begin;
+
+    bool negative = false;
+    if (p < end && ('-' == *p || '+' == *p))
+        negative = ('-' == *p++);
+
+    quint64 mantissa = 0;
+    int mantissaDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool exact = true;
+
+    for (; p < end && isDigit(*p); ++p) {
+        hasDigits = true;
+        if (mantissaDigits < maxMantissaDigits) {
+            mantissa = mantissa*10 + (*p - '0');
+            if (mantissa)
+                mantissaDigits++;
+        } else {
+            exponent++;
+            exact &= ('0' == *p);
+        }
+    }
+
+    if (p < end && '.' == *p) {
+        for (++p; p < end && isDigit(*p); ++p) {
+            hasDigits = true;
+            if (mantissaDigits < maxMantissaDigits) {
+                mantissa = mantissa*10 + (*p - '0');
+                if (mantissa)
+                    mantissaDigits++;
+                exponent--;
+            } else {
+                exact &= ('0' == *p);
+            }
+        }
+    }
+
+    if (!hasDigits)
+        return begin;
+
+    if (p < end && ('e' == *p || 'E' == *p)) {
+        const ushort *e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && ('-' == *e || '+' == *e))
+            negativeExponent = ('-' == *e++);
+        if (e < end && isDigit(*e)) {
+            int exponentValue = 0;
+            for (; e < end && isDigit(*e); ++e)
+                if (exponentValue < 100000)
+                    exponentValue = exponentValue*10 + (*e - '0');
+            exponent += negativeExponent ? -exponentValue : exponentValue;
+            p = e;
+        }
+    }
+
+    if (!mantissa) {
+        value = negative ? -0.0 : 0.0;
+    } else if (exact && mantissaDigits <= maxExactMantissaDigits && qAbs(exponent) <= maxExactPowerOf10) {
+        // both operands are exact, so the single rounding of the division or
+        // multiplication gives the correctly rounded result
+        double result = (double)(qint64)mantissa;
+        result = (exponent < 0) ? result / exactPowersOf10[-exponent] : result * exactPowersOf10[exponent];
+        value = negative ? -result : result;
+    } else {
+        value = QString::fromRawData(reinterpret_cast<const QChar*>(begin), p - begin).toDouble();
+    }
+
+    return p;
+}
+
+qreal UBCFFNumericCodec::parseNumber(const QString &text, bool *ok)
+{
+    const ushort *begin = text.utf16();
+    const ushort *end = begin + text.length();
+    while (begin < end && isSeparator(*begin))
+        ++begin;
+    while (end > begin && isSeparator(*(end - 1)))
+        --end;
+
+    qreal value = 0;
+    const ushort *parsedEnd = parseNumber(begin, end, value);
+    bool parsed = (parsedEnd != begin && parsedEnd == end);
+    if (ok)
+        *ok = parsed;
+
+    return parsed ? value : 0;
+}
+
+// Numbers delimited by spaces and/or commas, as in points, viewBox or matrix(...) arguments
+bool UBCFFNumericCodec::parseNumberList(const QString &text, QVector<qreal> &numbers)
+{
+    const ushort *p = text.utf16();
+    const ushort *end = p + text.length();
+
+    while (p < end) {
+        if (isSeparator(*p)) {
+            ++p;
+            continue;
+        }
+
+        qreal value = 0;
+        const ushort *next = parseNumber(p, end, value);
+        if (next == p)
+            return false;
+
+        numbers.append(value);
+        p = next;
+    }
+
+    return true;
+}
+
+void UBCFFNumericCodec::appendNumber(QString &output, qreal value, int decimals)
+{
+    if (qIsNaN(value) || qIsInf(value)) {
+        output += QString::number(value);
+        return;
+    }
+
+    qint64 integer = 0;
+    int fractionDigits = 0;
+
+    if (decimals >= 0) {
+        if (decimals > maxFixedDecimals || qAbs(value) >= 1e9) {
+            output += QString::number(value, 'f', decimals);
+            return;
+        }
+        integer = qRound64(value * exactPowersOf10[decimals]);
+        fractionDigits = decimals;
+        while (fractionDigits > 0 && 0 == integer % 10) {
+            integer /= 10;
+            fractionDigits--;
+        }
+    } else {
+        if (qAbs(value) >= 1e15 || value != (qreal)(qint64)value) {
+            // the shortest of the representations reading back to the same double
+            for (int precision = maxExactMantissaDigits; precision < 17; precision++) {
+                QString shortest = QString::number(value, 'g', precision);
+                if (shortest.toDouble() == value) {
+                    output += shortest;
+                    return;
+                }
+            }
+            output += QString::number(value, 'g', 17);
+            return;
+        }
+        integer = (qint64)value;
+    }
+
+    char buffer[32];
+    int pos = sizeof(buffer) - 1;
+    buffer[pos] = '\0';
+
+    bool negative = integer < 0;
+    quint64 digits = negative ? (quint64)(-integer) : (quint64)integer;
+    for (int i = 0; i < fractionDigits; i++) {
+        buffer[--pos] = '0' + digits % 10;
+        digits /= 10;
+    }
+    if (fractionDigits)
+        buffer[--pos] = '.';
+    do {
+        buffer[--pos] = '0' + digits % 10;
+        digits /= 10;
+    } while (digits);
+    if (negative)
+        buffer[--pos] = '-';
+
+    output += QLatin1String(buffer + pos);
+}
+
+QString UBCFFNumericCodec::formatNumber(qreal value, int decimals)
+{
+    QString result;
+    appendNumber(result, value, decimals);
+    return result;
+}
+
+QString UBCFFNumericCodec::formatNumberList(const QVector<qreal> &numbers, int decimals)
+{
+    QString result;
+    result.reserve(numbers.count()*8);
+    for (int i = 0; i < numbers.count(); i++) {
+        if (i)
+            result += QLatin1Char(' ');
+        appendNumber(result, numbers.at(i), decimals);
+    }
+    return result;
+}
+
+// "x1,y1 x2,y2 ..." as svg polygon and polyline points are written
+QString UBCFFNumericCodec::formatPoints(const QVector<qreal> &coordinates, int decimals)
+{
+    QString result;
+    result.reserve(coordinates.count()*8);
+    for (int i = 0; i < coordinates.count(); i++) {
+        if (i)
+            result += QLatin1Char(i % 2 ? ',' : ' ');
+        appendNumber(result, coordinates.at(i), decimals);
+    }
+    return result;
+}
+
+UBCFFPrecisionPolicy::UBCFFPrecisionPolicy(int coordinateDecimals, int sizeDecimals, int angleDecimals, qreal snapDistance)
+    : mSnapDistance(snapDistance)
+{
+    mDecimals[Coordinate] = coordinateDecimals;
+    mDecimals[Size] = sizeDecimals;
+    mDecimals[Angle] = angleDecimals;
+}
+
+// every value written so that it reads back exactly
+UBCFFPrecisionPolicy UBCFFPrecisionPolicy::lossless()
+{
+    return UBCFFPrecisionPolicy(UBCFFNumericCodec::SHORTEST, UBCFFNumericCodec::SHORTEST, UBCFFNumericCodec::SHORTEST, 0);
+}
+
+// a tenth of a pixel or degree, well below what a board display shows
+UBCFFPrecisionPolicy UBCFFPrecisionPolicy::compact()
+{
+    return UBCFFPrecisionPolicy(1, 1, 1, 0.05);
+}
+
+QString UBCFFPrecisionPolicy::key() const
+{
+    return QString("%1,%2,%3,%4").arg(mDecimals[Coordinate])
+                                 .arg(mDecimals[Size])
+                                 .arg(mDecimals[Angle])
+                                 .arg(mSnapDistance);
+}
+
+void UBCFFPrecisionPolicy::appendNumber(QString &output, qreal value, ValueClass valueClass) const
+{
+    if (mSnapDistance > 0) {
+        qreal integer = floor(value + 0.5);
+        if (qAbs(value - integer) < mSnapDistance)
+            value = integer;
+    }
+
+    UBCFFNumericCodec::appendNumber(output, value, mDecimals[valueClass]);
+}
+
+QString UBCFFPrecisionPolicy::format(qreal value, ValueClass valueClass) const
+{
+    QString result;
+    appendNumber(result, value, valueClass);
+    return result;
+}
+
+// Points are written with the same decimals and delimiters throughout, so the
+// repeating digit patterns of close points compress well in the archive
+QString UBCFFPrecisionPolicy::formatPoints(const QVector<qreal> &coordinates) const
+{
+    QString result;
+    result.reserve(coordinates.count()*8);
+    for (int i = 0; i < coordinates.count(); i++) {
+        if (i)
+            result += QLatin1Char(i % 2 ? ',' : ' ');
+        appendNumber(result, coordinates.at(i), Coordinate);
+    }
+    return result;
+}
@@ -0,0 +1,63 @@
+#ifndef UBCFFNUMERICCODEC_H
+#define UBCFFNUMERICCODEC_H
+
+#include "UBCFFAdaptor_global.h"
+
+#include <QtCore>
+
+// Numbers of the geometry attributes: coordinates, sizes, transforms and points lists.
+// Parsing works on the string data in place, without a QString per number, and takes
+// exact decimal -> double shortcuts for the short numbers found in documents.
+// Formatting writes either the fewest digits that read back to the same value or
+// a fixed number of decimals with the trailing zeros cut.
+class UBCFFADAPTORSHARED_EXPORT UBCFFNumericCodec
+{
+public:
+    static const int SHORTEST = -1;
+
+    static qreal parseNumber(const QString &text, bool *ok = NULL);
+    static bool parseNumberList(const QString &text, QVector<qreal> &numbers);
+
+    static QString formatNumber(qreal value, int decimals = SHORTEST);
+    static QString formatNumberList(const QVector<qreal> &numbers, int decimals = SHORTEST);
+    static QString formatPoints(const QVector<qreal> &coordinates, int decimals = SHORTEST);
+
+    static void appendNumber(QString &output, qreal value, int decimals = SHORTEST);
+
+private:
+    static const ushort *parseNumber(const ushort *begin, const ushort *end, qreal &value);
+};
+
+// How many decimals the output geometry gets, per kind of value.
+// Values closer to an integer than snapDistance are written as that integer,
+// which keeps pixel aligned values short whatever the decimals are.
+class UBCFFADAPTORSHARED_EXPORT UBCFFPrecisionPolicy
+{
+public:
+    enum ValueClass
+    {
+        Coordinate = 0, // x, y, points, translations
+        Size,           // width, height, stroke-width
+        Angle,          // rotations
+        ValueClassCount
+    };
+
+    UBCFFPrecisionPolicy(int coordinateDecimals = 3, int sizeDecimals = 3, int angleDecimals = 3, qreal snapDistance = 0);
+
+    static UBCFFPrecisionPolicy lossless();
+    static UBCFFPrecisionPolicy compact();
+
+    int decimals(ValueClass valueClass) const {return mDecimals[valueClass];}
+    qreal snapDistance() const {return mSnapDistance;}
+    QString key() const;
+
+    void appendNumber(QString &output, qreal value, ValueClass valueClass) const;
+    QString format(qreal value, ValueClass valueClass) const;
+    QString formatPoints(const QVector<qreal> &coordinates) const;
+
+private:
+    int mDecimals[ValueClassCount];
+    qreal mSnapDistance;
+};
+
+#endif // UBCFFNUMERICCODEC_H
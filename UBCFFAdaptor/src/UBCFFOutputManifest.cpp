@@ -0,0 +1,94 @@
+#include "UBCFFOutputManifest.h"
+
+#include "UBGlobals.h"
+#include "UBCFFConstants.h"
+
+THIRD_PARTY_WARNINGS_DISABLE
+#include "zlib.h"
+THIRD_PARTY_WARNINGS_ENABLE
+
+UBCFFOutputManifest::UBCFFOutputManifest(const QString &rootPath)
+    : mRootPath(rootPath)
+{}
+
+QString UBCFFOutputManifest::filePath(const QString &path) const
+{
+    return mRootPath + "/" + path;
+}
+
+bool UBCFFOutputManifest::writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(filePath(path));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qDebug() << "can't write output file" << file.fileName() << file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    addEntry(path, data.size(), crc32(crc32(0L, Z_NULL, 0), (const Bytef*)data.constData(), data.size()));
+
+    return true;
+}
+
+// like QFile::copy(), the crc is computed on the way
+bool UBCFFOutputManifest::copyFile(const QString &from, const QString &path)
+{
+    QFile sourceFile(from);
+    if (!sourceFile.open(QIODevice::ReadOnly)) {
+        qDebug() << "can't open file" << from << "for reading";
+        return false;
+    }
+
+    QFile file(filePath(path));
+    if (file.exists() || !file.open(QIODevice::WriteOnly)) {
+        qDebug() << "can't write output file" << file.fileName();
+        return false;
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    qint64 size = 0;
+    while (!sourceFile.atEnd()) {
+        QByteArray chunk = sourceFile.read(iZipCopyChunkSize);
+        if (chunk.isEmpty() || file.write(chunk) != chunk.size()) {
+            qDebug() << "can't copy" << from << "to" << file.fileName();
+            file.close();
+            file.remove();
+            return false;
+        }
+        crc = crc32(crc, (const Bytef*)chunk.constData(), chunk.size());
+        size += chunk.size();
+    }
+    file.close();
+
+    addEntry(path, size, (quint32)crc);
+
+    return true;
+}
+
+UBCFFOutputManifest::Compression UBCFFOutputManifest::compressionFor(const QString &path)
+{
+    QString extention = QFileInfo(path).suffix().toLower();
+    if (!extention.isEmpty() && cffStoredFileFormats.contains(extention))
+        return Store;
+
+    return Deflate;
+}
+
+// a file written again replaces its entry and keeps its position
+void UBCFFOutputManifest::addEntry(const QString &path, qint64 size, quint32 crc)
+{
+    Entry entry;
+    entry.path = path;
+    entry.size = size;
+    entry.crc = crc;
+    entry.compression = compressionFor(path);
+
+    if (mIndex.contains(path)) {
+        mEntries[mIndex.value(path)] = entry;
+    } else {
+        mIndex.insert(path, mEntries.count());
+        mEntries.append(entry);
+    }
+}
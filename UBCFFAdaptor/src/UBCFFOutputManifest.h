@@ -0,0 +1,44 @@
+#ifndef UBCFFOUTPUTMANIFEST_H
+#define UBCFFOUTPUTMANIFEST_H
+
+#include <QtCore>
+
+// Files the converter writes to its destination folder, in the order they are written.
+// The archive is packed from the manifest instead of walking the folder. An entry keeps
+// the size and the crc computed while the file was written and tells how to pack it:
+// media compressed already (png, jpeg, mp3...) are stored, the rest is deflated.
+class UBCFFOutputManifest
+{
+public:
+    enum Compression {Deflate, Store};
+
+    struct Entry
+    {
+        QString path; // relative to the root folder, the name of the archive entry
+        qint64 size;
+        quint32 crc;
+        Compression compression;
+    };
+
+    UBCFFOutputManifest(const QString &rootPath);
+
+    QString rootPath() const {return mRootPath;}
+    QString filePath(const QString &path) const;
+
+    bool writeFile(const QString &path, const QByteArray &data);
+    bool copyFile(const QString &from, const QString &path);
+    bool contains(const QString &path) const {return mIndex.contains(path);}
+
+    const QList<Entry> &entries() const {return mEntries;}
+
+    static Compression compressionFor(const QString &path);
+
+private:
+    void addEntry(const QString &path, qint64 size, quint32 crc);
+
+    QString mRootPath;
+    QList<Entry> mEntries;
+    QHash<QString, int> mIndex; // entry position by path
+};
+
+#endif // UBCFFOUTPUTMANIFEST_H
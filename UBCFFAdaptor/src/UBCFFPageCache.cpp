@@ -0,0 +1,248 @@
+#include "UBCFFPageCache.h"
+
+#include "UBCFFConstants.h"
+
+UBCFFPageCache::UBCFFPageCache(const QString &cacheDir)
+    : mCacheDir(cacheDir)
+{}
+
+bool UBCFFPageCache::load()
+{
+    mEntries.clear();
+    mUsedKeys.clear();
+
+    QFile manifestFile(mCacheDir + "/" + fPageCacheManifest);
+    if (!manifestFile.exists())
+        return true; // first conversion, nothing cached yet
+
+    QDomDocument manifest;
+    if (!manifestFile.open(QIODevice::ReadOnly) || !manifest.setContent(&manifestFile)) {
+        qDebug() << "can't read page cache manifest" << manifestFile.fileName() << ", ignoring the cache";
+        return false;
+    }
+
+    QDomElement root = manifest.documentElement();
+    if (root.attribute(aIWBVersion) != avPageCacheVersion) {
+        qDebug() << "page cache was written by another converter version, ignoring it";
+        return true;
+    }
+
+    for (QDomElement page = root.firstChildElement(tIWBPage); !page.isNull(); page = page.nextSiblingElement(tIWBPage)) {
+        Entry entry;
+        entry.pageFileName = page.attribute(aSrc);
+        QStringList viewbox = page.attribute(aIWBViewBox).split(dimensionsDelimiter2, QString::SkipEmptyParts);
+        if (4 == viewbox.count())
+            entry.pageViewbox = QRect(viewbox.at(0).toInt(), viewbox.at(1).toInt(), viewbox.at(2).toInt(), viewbox.at(3).toInt());
+        for (QDomElement media = page.firstChildElement(tPageCacheMedia); !media.isNull(); media = media.nextSiblingElement(tPageCacheMedia))
+            entry.mediaFiles << media.attribute(aSrc);
+
+        mEntries.insert(page.attribute(aPageCacheKey), entry);
+    }
+
+    return true;
+}
+
+// Writes the manifest for the pages of the last conversion and drops everything else
+bool UBCFFPageCache::save()
+{
+    if (!QDir().mkpath(mCacheDir)) {
+        qDebug() << "can't create page cache folder" << mCacheDir;
+        return false;
+    }
+
+    QSet<QString> usedMedia;
+    foreach (QString key, mUsedKeys)
+        foreach (QString mediaFile, mEntries.value(key).mediaFiles)
+            usedMedia.insert(mediaFile);
+
+    QMapIterator<QString, Entry> nextEntry(mEntries);
+    while (nextEntry.hasNext()) {
+        nextEntry.next();
+        if (mUsedKeys.contains(nextEntry.key()))
+            continue;
+        QFile::remove(fragmentFilePath(nextEntry.key()));
+        foreach (QString mediaFile, nextEntry.value().mediaFiles)
+            if (!usedMedia.contains(mediaFile))
+                QFile::remove(mediaFilePath(mediaFile));
+    }
+
+    QFile manifestFile(mCacheDir + "/" + fPageCacheManifest);
+    if (!manifestFile.open(QIODevice::WriteOnly)) {
+        qDebug() << "can't write page cache manifest" << manifestFile.fileName();
+        return false;
+    }
+
+    QXmlStreamWriter writer(&manifestFile);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+    writer.writeStartElement(tPageCacheRoot);
+    writer.writeAttribute(aIWBVersion, avPageCacheVersion);
+
+    foreach (QString key, mUsedKeys) {
+        const Entry entry = mEntries.value(key);
+        writer.writeStartElement(tIWBPage);
+        writer.writeAttribute(aPageCacheKey, key);
+        writer.writeAttribute(aSrc, entry.pageFileName);
+        writer.writeAttribute(aIWBViewBox, QString("%1 %2 %3 %4").arg(entry.pageViewbox.x())
+                                                                 .arg(entry.pageViewbox.y())
+                                                                 .arg(entry.pageViewbox.width())
+                                                                 .arg(entry.pageViewbox.height()));
+        foreach (QString mediaFile, entry.mediaFiles) {
+            writer.writeStartElement(tPageCacheMedia);
+            writer.writeAttribute(aSrc, mediaFile);
+            writer.writeEndElement();
+        }
+        writer.writeEndElement();
+    }
+
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    manifestFile.close();
+
+    return true;
+}
+
+QString UBCFFPageCache::previousArchive() const
+{
+    return mCacheDir + "/" + fPageCachePreviousArchive;
+}
+
+QString UBCFFPageCache::mediaFilePath(const QString &mediaFile) const
+{
+    return mCacheDir + "/" + cfPageCacheMedia + "/" + mediaFile;
+}
+
+QString UBCFFPageCache::fragmentFilePath(const QString &key) const
+{
+    return mCacheDir + "/" + cfPageCachePages + "/" + key + ".xml";
+}
+
+QByteArray UBCFFPageCache::fileHash(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    while (!file.atEnd())
+        hash.addData(file.read(64*1024));
+
+    return hash.result();
+}
+
+// The key covers the page svg, every file it references (with the png previews the
+// converter takes instead of widgets and svg images) and the conversion context
+QString UBCFFPageCache::pageKey(const QString &sourcePath, const QString &pageFileName, const QString &context)
+{
+    QFile pageFile(sourcePath + "/" + pageFileName);
+    if (!pageFile.open(QIODevice::ReadOnly))
+        return QString();
+    QByteArray pageData = pageFile.readAll();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(avPageCacheVersion.toUtf8());
+    hash.addData(context.toUtf8());
+    hash.addData(pageData);
+
+    QRegExp reference("\\b(?:href|src)=\"([^\"]+)\"");
+    QString pageText = QString::fromUtf8(pageData);
+    int pos = 0;
+    while ((pos = reference.indexIn(pageText, pos)) != -1) {
+        pos += reference.matchedLength();
+
+        QString href = reference.cap(1);
+        if (href.startsWith("#") || href.contains("://"))
+            continue;
+
+        QFileInfo hrefInfo(sourcePath + "/" + href);
+        QString preview = hrefInfo.absolutePath() + "/" + hrefInfo.completeBaseName() + "." + fePng;
+        QStringList referencedFiles;
+        referencedFiles << hrefInfo.absoluteFilePath() << preview << QString(preview).remove("{").remove("}");
+
+        foreach (QString referencedFile, referencedFiles) {
+            if (QFileInfo(referencedFile).isFile()) {
+                hash.addData(referencedFile.toUtf8());
+                hash.addData(fileHash(referencedFile));
+            }
+        }
+    }
+
+    return QString(hash.result().toHex());
+}
+
+QDomElement UBCFFPageCache::restorePage(const QString &key, QDomDocument *document,
+                                        QList<QDomElement> &extendedElements, QRect &pageViewbox, QStringList &mediaFiles)
+{
+    if (key.isEmpty() || !mEntries.contains(key))
+        return QDomElement();
+
+    const Entry entry = mEntries.value(key);
+    foreach (QString mediaFile, entry.mediaFiles)
+        if (!QFile::exists(mediaFilePath(mediaFile)))
+            return QDomElement();
+
+    QFile fragmentFile(fragmentFilePath(key));
+    QDomDocument fragment;
+    if (!fragmentFile.open(QIODevice::ReadOnly) || !fragment.setContent(&fragmentFile, true))
+        return QDomElement();
+
+    QDomElement root = fragment.documentElement();
+    QDomElement page = root.firstChildElement();
+    if (page.isNull())
+        return QDomElement();
+
+    for (QDomElement extended = page.nextSiblingElement(); !extended.isNull(); extended = extended.nextSiblingElement())
+        extendedElements.append(document->importNode(extended, true).toElement());
+
+    pageViewbox = entry.pageViewbox;
+    mediaFiles = entry.mediaFiles;
+    mUsedKeys.insert(key);
+
+    return document->importNode(page, true).toElement();
+}
+
+bool UBCFFPageCache::storePage(const QString &key, const QString &pageFileName, const QDomElement &page,
+                               const QList<QDomElement> &extendedElements, const QRect &pageViewbox,
+                               const QStringList &mediaFiles, const QString &mediaRoot)
+{
+    if (key.isEmpty())
+        return false;
+
+    foreach (QString mediaFile, mediaFiles) {
+        QString cachedMediaFile = mediaFilePath(mediaFile);
+        QDir().mkpath(QFileInfo(cachedMediaFile).absolutePath());
+        QFile::remove(cachedMediaFile);
+        if (!QFile::copy(mediaRoot + "/" + mediaFile, cachedMediaFile)) {
+            qDebug() << "can't cache media file" << mediaFile;
+            return false;
+        }
+    }
+
+    // the page element goes first, its extended iwb elements follow it
+    QDomDocument fragment;
+    QDomElement root = fragment.createElement(tPageCacheRoot);
+    root.setAttribute("xmlns:" + xlinkNSPrefix, xlinkNS);
+    fragment.appendChild(root);
+    root.appendChild(fragment.importNode(page, true));
+    foreach (QDomElement extended, extendedElements)
+        root.appendChild(fragment.importNode(extended, true));
+
+    QString fragmentPath = fragmentFilePath(key);
+    QDir().mkpath(QFileInfo(fragmentPath).absolutePath());
+    QFile fragmentFile(fragmentPath);
+    if (!fragmentFile.open(QIODevice::WriteOnly)) {
+        qDebug() << "can't write page cache fragment" << fragmentPath;
+        return false;
+    }
+    fragmentFile.write(fragment.toByteArray(-1));
+    fragmentFile.close();
+
+    Entry entry;
+    entry.pageFileName = pageFileName;
+    entry.pageViewbox = pageViewbox;
+    entry.mediaFiles = mediaFiles;
+    mEntries.insert(key, entry);
+    mUsedKeys.insert(key);
+
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef UBCFFPAGECACHE_H
+#define UBCFFPAGECACHE_H
+
+#include <QtCore>
+#include <QtXml>
+
+// Cache of converted pages kept next to the output file for incremental re-conversion.
+// A page is looked up by a key hashing its svg source, the files it references and
+// everything else its conversion depends on. An entry keeps the converted page
+// element, its extended iwb elements, the page viewbox and the media files it produced.
+class UBCFFPageCache
+{
+public:
+    UBCFFPageCache(const QString &cacheDir);
+
+    bool load();
+    bool save();
+
+    QString cacheDir() const {return mCacheDir;}
+    QString previousArchive() const;
+    QString mediaFilePath(const QString &mediaFile) const;
+
+    QString pageKey(const QString &sourcePath, const QString &pageFileName, const QString &context);
+
+    QDomElement restorePage(const QString &key, QDomDocument *document,
+                            QList<QDomElement> &extendedElements, QRect &pageViewbox, QStringList &mediaFiles);
+    bool storePage(const QString &key, const QString &pageFileName, const QDomElement &page,
+                   const QList<QDomElement> &extendedElements, const QRect &pageViewbox,
+                   const QStringList &mediaFiles, const QString &mediaRoot);
+
+private:
+    struct Entry
+    {
+        QString pageFileName;
+        QRect pageViewbox;
+        QStringList mediaFiles;
+    };
+
+    QByteArray fileHash(const QString &filePath) const;
+    QString fragmentFilePath(const QString &key) const;
+
+    QString mCacheDir;
+    QMap<QString, Entry> mEntries; // by page key
+    QSet<QString> mUsedKeys; // keys restored or stored during this conversion
+};
+
+#endif // UBCFFPAGECACHE_H
@@ -0,0 +1,148 @@
+#include "UBCFFTmpReaper.h"
+
+#ifndef Q_OS_WIN
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+Q_GLOBAL_STATIC(UBCFFTmpReaper, tmpReaper)
+
+UBCFFTmpReaper::UBCFFTmpReaper()
+    : mStopping(false)
+{}
+
+// process exit: the queue is drained before the thread stops
+UBCFFTmpReaper::~UBCFFTmpReaper()
+{
+    mMutex.lock();
+    mStopping = true;
+    mQueued.wakeAll();
+    mMutex.unlock();
+
+    wait();
+
+    foreach (QString dir, mQueue)
+        removeTree(dir);
+}
+
+UBCFFTmpReaper *UBCFFTmpReaper::instance()
+{
+    return tmpReaper();
+}
+
+void UBCFFTmpReaper::enqueue(const QString &dir)
+{
+    QMutexLocker locker(&mMutex);
+    mQueue.append(dir);
+    if (mStopping)
+        return;
+    if (!isRunning())
+        start(QThread::LowPriority);
+    mQueued.wakeOne();
+}
+
+void UBCFFTmpReaper::run()
+{
+    forever {
+        mMutex.lock();
+        while (mQueue.isEmpty() && !mStopping)
+            mQueued.wait(&mMutex);
+        if (mQueue.isEmpty()) {
+            mMutex.unlock();
+            return;
+        }
+        QString dir = mQueue.takeFirst();
+        mMutex.unlock();
+
+        if (!removeTree(dir))
+            qDebug() << "can't delete tmp directory" << dir << "try to delete them manually";
+    }
+}
+
+#ifndef Q_OS_WIN
+
+// Empties the folder open as dirFd and closes dirFd. Entries are removed by their names
+// relative to the folder, subfolders are opened relative to it and emptied the same way
+static bool removeDirContents(int dirFd)
+{
+    DIR *dir = ::fdopendir(dirFd);
+    if (!dir) {
+        ::close(dirFd);
+        return false;
+    }
+
+    bool result = true;
+    struct dirent *entry;
+    while ((entry = ::readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        // the entry type is unknown on some file systems, unlinkat tells then
+        if (entry->d_type != DT_DIR) {
+            if (0 == ::unlinkat(dirFd, name, 0))
+                continue;
+            if (errno != EISDIR && errno != EPERM) {
+                result = false;
+                continue;
+            }
+        }
+
+        int subdirFd = ::openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (-1 == subdirFd || !removeDirContents(subdirFd) || 0 != ::unlinkat(dirFd, name, AT_REMOVEDIR))
+            result = false;
+    }
+
+    ::closedir(dir);
+    return result;
+}
+
+bool UBCFFTmpReaper::removeTree(const QString &dir)
+{
+    if (dir == "" || dir == "." || dir == "..")
+        return false;
+
+    QByteArray encodedDir = QFile::encodeName(dir);
+    int dirFd = ::open(encodedDir.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (-1 == dirFd)
+        return false;
+
+    bool result = removeDirContents(dirFd);
+    return 0 == ::rmdir(encodedDir.constData()) && result;
+}
+
+#else
+
+bool UBCFFTmpReaper::removeTree(const QString &dir)
+{
+    if (dir == "" || dir == "." || dir == "..")
+        return false;
+
+    QDir qdir(dir);
+
+    if (qdir.exists())
+    {
+        foreach(QFileInfo dirContent, qdir.entryInfoList(QDir::Files | QDir::Dirs
+                | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System, QDir::Name))
+        {
+            if (dirContent.isDir())
+            {
+                removeTree(dirContent.absoluteFilePath());
+            }
+            else
+            {
+                if (!dirContent.dir().remove(dirContent.fileName()))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return qdir.rmdir(dir);
+}
+
+#endif
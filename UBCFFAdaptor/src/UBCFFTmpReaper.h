@@ -0,0 +1,35 @@
+#ifndef UBCFFTMPREAPER_H
+#define UBCFFTMPREAPER_H
+
+#include <QtCore>
+
+// Deletes the temporary workspaces of the conversions on a background thread, so a
+// conversion returns as soon as its output is finalized. One reaper serves all the
+// adaptors of the process, its thread is started by the first folder queued.
+// Folders still queued when the process exits are deleted before the reaper is destroyed,
+// instance() returns NULL after that and the caller has to delete the folder itself.
+class UBCFFTmpReaper : public QThread
+{
+public:
+    UBCFFTmpReaper();
+    ~UBCFFTmpReaper();
+
+    static UBCFFTmpReaper *instance();
+
+    void enqueue(const QString &dir);
+
+    // deletes the whole tree on the calling thread. On POSIX systems the tree is walked
+    // through directory descriptors (fdopendir/unlinkat/openat) without building full paths
+    static bool removeTree(const QString &dir);
+
+protected:
+    void run();
+
+private:
+    QMutex mMutex;
+    QWaitCondition mQueued;
+    QStringList mQueue;
+    bool mStopping;
+};
+
+#endif // UBCFFTMPREAPER_H
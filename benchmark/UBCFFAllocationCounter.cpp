@@ -0,0 +1,78 @@
+#include "UBCFFAllocationCounter.h"
+
+#include <new>
+#include <stdlib.h>
+
+// dynamic exception specifications are deprecated in C++11 and an error in C++17
+#if __cplusplus >= 201103L
+#define ALLOCATION_THROWS
+#define ALLOCATION_NOTHROW noexcept
+#else
+#define ALLOCATION_THROWS throw(std::bad_alloc)
+#define ALLOCATION_NOTHROW throw()
+#endif
+
+// initialized statically, operator new is called before any constructor runs
+static QBasicAtomicInt allocationCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+quint32 UBCFFAllocationCounter::allocations()
+{
+    return (quint32)allocationCount.fetchAndAddRelaxed(0);
+}
+
+void *operator new(size_t size) ALLOCATION_THROWS
+{
+    allocationCount.ref();
+    void *memory = malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new[](size_t size) ALLOCATION_THROWS
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) ALLOCATION_NOTHROW
+{
+    allocationCount.ref();
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) ALLOCATION_NOTHROW
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *memory) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void *memory, size_t) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) ALLOCATION_NOTHROW
+{
+    free(memory);
+}
+#endif
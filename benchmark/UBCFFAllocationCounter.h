@@ -0,0 +1,17 @@
+#ifndef UBCFFALLOCATIONCOUNTER_H
+#define UBCFFALLOCATIONCOUNTER_H
+
+#include <QtCore>
+
+// Counts the allocations made with operator new in the benchmark process: QDom nodes,
+// QObjects, list and map nodes of the adaptor and of Qt. Buffers Qt takes with qMalloc(),
+// like the data of strings and byte arrays, are not counted. On Windows only the
+// allocations of the benchmark itself are, every dll has its own operator new there.
+// The count wraps around at 2^32, the difference over one conversion is exact
+class UBCFFAllocationCounter
+{
+public:
+    static quint32 allocations();
+};
+
+#endif // UBCFFALLOCATIONCOUNTER_H
@@ -0,0 +1,525 @@
+#include "UBCFFBenchmark.h"
+
+#include "UBCFFAdaptor.h"
+#include "UBCFFAllocationCounter.h"
+#include "UBCFFConversionJob.h"
+#include "UBCFFConstants.h"
+#include "UBGlobals.h"
+
+THIRD_PARTY_WARNINGS_DISABLE
+#include "quazip.h"
+#include "quazipfile.h"
+THIRD_PARTY_WARNINGS_ENABLE
+
+#ifndef Q_OS_WIN
+#include <sys/resource.h>
+#endif
+
+static const int iTmpDirStressJobs = 256;
+static const int iTmpDirReaperTimeout = 60000; // ms
+
+UBCFFBenchmark::UBCFFBenchmark(const QString &workDir, int repeat)
+    : mWorkDir(workDir)
+    , mRepeat(qMax(1, repeat))
+{}
+
+// Page scaling up to 10k pages (from the ubz and from its unpacked folder), each kind of content
+// alone, the serializer with and without indentation (100k elements) and the precision presets
+// on a stroke heavy document.
+// The quick suite has the same cases with a tenth of the pages, for smoke runs
+QList<UBCFFBenchmarkCase> UBCFFBenchmark::suite(bool quick)
+{
+    QList<UBCFFBenchmarkCase> cases;
+    UBCFFBenchmarkCase benchmarkCase;
+
+    int pageCounts[] = {10, 100, 1000, 10000};
+    for (int i = 0; i < 4; i++) {
+        benchmarkCase = UBCFFBenchmarkCase();
+        benchmarkCase.name = QString("pages-%1").arg(pageCounts[i]);
+        benchmarkCase.document.pages = pageCounts[i];
+        benchmarkCase.document.imagesPerPage = 0;
+        benchmarkCase.directoryInput = true;
+        cases << benchmarkCase;
+    }
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "strokes";
+    benchmarkCase.document.pages = 10;
+    benchmarkCase.document.strokesPerPage = 200;
+    benchmarkCase.document.segmentsPerStroke = 50;
+    benchmarkCase.document.textsPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    cases << benchmarkCase;
+
+    // one page of 50k stroke segments, the result model and the node factory at their worst
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "strokes-50k";
+    benchmarkCase.document.pages = 1;
+    benchmarkCase.document.strokesPerPage = 1000;
+    benchmarkCase.document.segmentsPerStroke = 50;
+    benchmarkCase.document.textsPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "texts";
+    benchmarkCase.document.pages = 20;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.textsPerPage = 50;
+    benchmarkCase.document.imagesPerPage = 0;
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "images";
+    benchmarkCase.document.pages = 10;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 5;
+    benchmarkCase.document.imageSize = QSize(1024, 768);
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "svg-images";
+    benchmarkCase.document.pages = 10;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    benchmarkCase.document.svgImagesPerPage = 10;
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "video-audio";
+    benchmarkCase.document.pages = 10;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    benchmarkCase.document.videos = 5;
+    benchmarkCase.document.videoSize = 16*1024*1024;
+    benchmarkCase.document.audios = 10;
+    benchmarkCase.document.audioSize = 1024*1024;
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.name = "widgets";
+    benchmarkCase.document.pages = 10;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    benchmarkCase.document.widgets = 20;
+    benchmarkCase.document.imageSize = QSize(400, 300);
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.document.pages = 100;
+    benchmarkCase.document.strokesPerPage = 0;
+    benchmarkCase.document.textsPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    benchmarkCase.document.linesPerPage = 1000;
+    benchmarkCase.name = "serializer-indented";
+    cases << benchmarkCase;
+    benchmarkCase.name = "serializer-compact";
+    benchmarkCase.compactOutput = true;
+    cases << benchmarkCase;
+
+    benchmarkCase = UBCFFBenchmarkCase();
+    benchmarkCase.document.pages = 20;
+    benchmarkCase.document.strokesPerPage = 100;
+    benchmarkCase.document.textsPerPage = 0;
+    benchmarkCase.document.imagesPerPage = 0;
+    benchmarkCase.name = "precision-lossless";
+    benchmarkCase.precisionName = "lossless";
+    benchmarkCase.precision = UBCFFPrecisionPolicy::lossless();
+    cases << benchmarkCase;
+    benchmarkCase.name = "precision-default";
+    benchmarkCase.precisionName = "default";
+    benchmarkCase.precision = UBCFFPrecisionPolicy();
+    cases << benchmarkCase;
+    benchmarkCase.name = "precision-compact";
+    benchmarkCase.precisionName = "compact";
+    benchmarkCase.precision = UBCFFPrecisionPolicy::compact();
+    cases << benchmarkCase;
+
+    if (quick) {
+        for (int i = 0; i < cases.count(); i++)
+            cases[i].document.pages = qMax(1, cases[i].document.pages / 10);
+    }
+
+    return cases;
+}
+
+QStringList UBCFFBenchmark::phaseNames()
+{
+    return QStringList() << "total" << "unzip" << "parse" << "rasterize" << "pack";
+}
+
+// named by the spec, a document is generated once and reused by the next runs
+QString UBCFFBenchmark::documentFile(const UBCFFBenchmarkCase &benchmarkCase) const
+{
+    uint specHash = qHash(benchmarkCase.document.toArguments().join(" "));
+    return mWorkDir + "/" + QString("synthetic-%1.ubz").arg(specHash, 8, 16, QChar('0'));
+}
+
+QString UBCFFBenchmark::documentDir(const UBCFFBenchmarkCase &benchmarkCase) const
+{
+    return QFileInfo(documentFile(benchmarkCase)).absolutePath() + "/" + QFileInfo(documentFile(benchmarkCase)).completeBaseName();
+}
+
+bool UBCFFBenchmark::prepareDocument(const UBCFFBenchmarkCase &benchmarkCase)
+{
+    if (!QDir().mkpath(mWorkDir)) {
+        qWarning() << "can't create benchmark folder" << mWorkDir;
+        return false;
+    }
+
+    if (QFile::exists(documentFile(benchmarkCase)))
+        return true;
+
+    UBCFFSyntheticDocument document(benchmarkCase.document);
+    return document.write(documentFile(benchmarkCase));
+}
+
+// the document unpacked the way the board keeps it, as a folder the adaptor converts without unzipping
+bool UBCFFBenchmark::prepareDocumentDir(const UBCFFBenchmarkCase &benchmarkCase)
+{
+    QString dir = documentDir(benchmarkCase);
+    QString doneFile = dir + ".done";
+    if (QFile::exists(doneFile))
+        return true;
+
+    QuaZip zip(documentFile(benchmarkCase));
+    if (!zip.open(QuaZip::mdUnzip)) {
+        qWarning() << "can't open" << zip.getZipName() << zip.getZipError();
+        return false;
+    }
+
+    QuaZipFile file(&zip);
+    for (bool more = zip.goToFirstFile(); more; more = zip.goToNextFile()) {
+        QString fileName = dir + "/" + zip.getCurrentFileName();
+        QDir().mkpath(QFileInfo(fileName).absolutePath());
+        QFile out(fileName);
+        if (!file.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly)) {
+            qWarning() << "can't unpack" << fileName;
+            return false;
+        }
+        while (!file.atEnd())
+            out.write(file.read(64*1024));
+        out.close();
+        file.close();
+        if (file.getZipError() != UNZ_OK) {
+            qWarning() << "can't unpack" << fileName << file.getZipError();
+            return false;
+        }
+    }
+
+    zip.close();
+
+    // created last, an interrupted unpacking is redone by the next run
+    QFile done(doneFile);
+    return done.open(QIODevice::WriteOnly);
+}
+
+// pages in the content.xml of an iwb, -1 if it can't be read
+int UBCFFBenchmark::outputPageCount(const QString &iwbFile)
+{
+    QuaZip zip(iwbFile);
+    if (!zip.open(QuaZip::mdUnzip) || !zip.setCurrentFile(fIWBContent))
+        return -1;
+
+    QuaZipFile content(&zip);
+    if (!content.open(QIODevice::ReadOnly))
+        return -1;
+
+    int pageCount = 0;
+    QXmlStreamReader reader(&content);
+    while (!reader.atEnd()) {
+        if (reader.readNext() == QXmlStreamReader::StartElement
+                && reader.namespaceUri() == svgIWBNS && reader.name() == tIWBPage)
+            pageCount++;
+    }
+
+    return reader.hasError() ? -1 : pageCount;
+}
+
+bool UBCFFBenchmark::checkPageCount(const UBCFFBenchmarkCase &benchmarkCase, const QString &iwbFile)
+{
+    int pageCount = outputPageCount(iwbFile);
+    if (pageCount == benchmarkCase.document.pages)
+        return true;
+
+    qWarning() << "benchmark" << benchmarkCase.name << "output has" << pageCount << "pages instead of" << benchmarkCase.document.pages;
+    return false;
+}
+
+QString UBCFFBenchmark::runCase(const UBCFFBenchmarkCase &benchmarkCase)
+{
+    if (!prepareDocument(benchmarkCase))
+        return QString();
+
+    QString ubzFile = documentFile(benchmarkCase);
+    QString iwbFile = mWorkDir + "/" + benchmarkCase.name + "." + "iwb";
+
+    UBCFFAdaptor adaptor;
+    adaptor.setCompactOutput(benchmarkCase.compactOutput);
+    adaptor.setPrecisionPolicy(benchmarkCase.precision);
+
+    // warm-up: loads the image and svg plugins, fills the file cache
+    if (!adaptor.convertUBZToIWB(ubzFile, iwbFile)) {
+        qWarning() << "benchmark" << benchmarkCase.name << "failed to convert" << ubzFile;
+        return QString();
+    }
+
+    QMap<QString, QList<qint64> > samples;
+    QList<quint32> allocations;
+    for (int i = 0; i < mRepeat; i++) {
+        QElapsedTimer timer;
+        quint32 allocationsBefore = UBCFFAllocationCounter::allocations();
+        timer.start();
+        if (!adaptor.convertUBZToIWB(ubzFile, iwbFile)) {
+            qWarning() << "benchmark" << benchmarkCase.name << "failed to convert" << ubzFile;
+            return QString();
+        }
+        qint64 total = timer.nsecsElapsed();
+        allocations << UBCFFAllocationCounter::allocations() - allocationsBefore;
+
+        UBCFFConversionProfile profile = adaptor.lastProfile();
+        samples["total"] << total;
+        samples["unzip"] << profile.unzipTime;
+        samples["parse"] << profile.parseTime;
+        samples["rasterize"] << profile.rasterizeTime;
+        samples["pack"] << profile.packTime;
+    }
+
+    qint64 inputSize = QFileInfo(ubzFile).size();
+    qint64 outputSize = QFileInfo(iwbFile).size();
+    if (!checkPageCount(benchmarkCase, iwbFile))
+        return QString();
+
+    if (benchmarkCase.directoryInput) {
+        if (!prepareDocumentDir(benchmarkCase)
+                || !adaptor.convertUBZToIWB(documentDir(benchmarkCase), iwbFile)
+                || !checkPageCount(benchmarkCase, iwbFile)) {
+            qWarning() << "benchmark" << benchmarkCase.name << "failed to convert" << documentDir(benchmarkCase);
+            return QString();
+        }
+    }
+    QFile::remove(iwbFile);
+
+    QList<qint64> totals = samples.value("total");
+    qSort(totals);
+    double medianSeconds = qMax(totals.at(totals.count() / 2) / 1e9, 1e-9);
+    qSort(allocations);
+
+    QString phases;
+    foreach (QString phase, phaseNames())
+        phases += QString("%1\"%2\": %3").arg(phases.isEmpty() ? "" : ", ").arg(phase).arg(statisticsJson(samples.value(phase)));
+
+    return QString("{\"name\": \"%1\", \"document\": %2, \"options\": {\"compactOutput\": %3, \"precision\": \"%4\"}, "
+                   "\"repeat\": %5, \"inputBytes\": %6, \"outputBytes\": %7, \"contentBytes\": %8, \"peakRssBytes\": %9, "
+                   "\"throughput\": {\"pagesPerSecond\": %10, \"inputMBPerSecond\": %11, \"outputMBPerSecond\": %12}, "
+                   "\"phases\": {%13}, \"allocations\": %14}")
+            .arg(benchmarkCase.name)
+            .arg(benchmarkCase.document.toJson())
+            .arg(benchmarkCase.compactOutput ? "true" : "false")
+            .arg(benchmarkCase.precisionName)
+            .arg(mRepeat)
+            .arg(inputSize)
+            .arg(outputSize)
+            .arg(adaptor.lastProfile().contentSize)
+            .arg(peakRss())
+            .arg(QString::number(benchmarkCase.document.pages / medianSeconds, 'f', 3))
+            .arg(QString::number(inputSize / 1e6 / medianSeconds, 'f', 3))
+            .arg(QString::number(outputSize / 1e6 / medianSeconds, 'f', 3))
+            .arg(phases)
+            .arg(allocations.at(allocations.count() / 2));
+}
+
+QString UBCFFBenchmark::runSuite(bool quick, const QString &filter)
+{
+    QStringList results;
+    foreach (UBCFFBenchmarkCase benchmarkCase, suite(quick)) {
+        if (!filter.isEmpty() && !benchmarkCase.name.contains(filter))
+            continue;
+
+        // generated here, the memory it takes doesn't count in the peak RSS of the case
+        if (!prepareDocument(benchmarkCase))
+            return QString();
+
+        QStringList arguments;
+        arguments << "--case" << benchmarkCase.name << "--repeat" << QString::number(mRepeat) << "--work" << mWorkDir;
+        if (quick)
+            arguments << "--quick";
+
+        QProcess child;
+        child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        child.start(QCoreApplication::applicationFilePath(), arguments);
+        if (!child.waitForFinished(-1) || child.exitStatus() != QProcess::NormalExit || child.exitCode() != 0) {
+            qWarning() << "benchmark" << benchmarkCase.name << "failed";
+            return QString();
+        }
+
+        QString result = QString::fromUtf8(child.readAllStandardOutput()).trimmed();
+        qWarning() << "benchmark" << benchmarkCase.name << "done";
+        results << result;
+    }
+
+    return QString("{\"format\": 1, \"suite\": \"%1\", \"repeat\": %2, \"date\": \"%3\", "
+                   "\"host\": {\"qt\": \"%4\", \"idealThreads\": %5}, \"benchmarks\": [\n%6\n]}\n")
+            .arg(quick ? "quick" : "full")
+            .arg(mRepeat)
+            .arg(QDateTime::currentDateTime().toUTC().toString(Qt::ISODate))
+            .arg(qVersion())
+            .arg(QThread::idealThreadCount())
+            .arg(results.join(",\n"));
+}
+
+// Checks that conversions started together never share a workspace and that
+// the reaper deletes every workspace once they are done
+bool UBCFFBenchmark::runTmpDirStress()
+{
+    UBCFFBenchmarkCase stressCase;
+    stressCase.name = "tmpdir-stress";
+    stressCase.document.pages = 3;
+    stressCase.document.strokesPerPage = 5;
+    stressCase.document.textsPerPage = 2;
+    stressCase.document.imagesPerPage = 1;
+    stressCase.document.imageSize = QSize(64, 48);
+    if (!prepareDocument(stressCase))
+        return false;
+
+    // a root of its own, whatever is left in it at the end was left by these jobs
+    QString runDir = mWorkDir + "/" + stressCase.name + "-" + QString::number(QCoreApplication::applicationPid());
+    QString tmpRoot = runDir + "/tmp";
+    if (!QDir().mkpath(tmpRoot)) {
+        qWarning() << "can't create" << tmpRoot;
+        return false;
+    }
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(iTmpDirStressJobs);
+
+    QList<UBCFFConversionJob*> jobs;
+    QList<UBCFFWorkspaceRecorder*> recorders;
+    for (int i = 0; i < iTmpDirStressJobs; i++) {
+        UBCFFConversionJob *job = new UBCFFConversionJob(documentFile(stressCase), QString("%1/%2.iwb").arg(runDir).arg(i));
+        job->adaptor()->setTmpRoot(tmpRoot);
+        UBCFFWorkspaceRecorder *recorder = new UBCFFWorkspaceRecorder(job);
+        QObject::connect(job, SIGNAL(pagesProgress(int,int)), recorder, SLOT(record()), Qt::DirectConnection);
+        jobs << job;
+        recorders << recorder;
+    }
+    foreach (UBCFFConversionJob *job, jobs)
+        job->start(&threadPool);
+
+    // every job unpacks the ubz to one workspace and converts it to another
+    bool allOk = true;
+    QMap<QString, int> workspaceJobs;
+    for (int i = 0; i < jobs.count(); i++) {
+        if (!jobs.at(i)->waitForFinished()) {
+            qWarning() << "tmpdir stress: conversion" << i << "failed";
+            allOk = false;
+        } else if (!checkPageCount(stressCase, jobs.at(i)->to())) {
+            allOk = false;
+        }
+        QFile::remove(jobs.at(i)->to());
+
+        QStringList workspaces = recorders.at(i)->workspaces();
+        if (2 != workspaces.count()) {
+            qWarning() << "tmpdir stress: conversion" << i << "used" << workspaces.count() << "workspaces instead of 2";
+            allOk = false;
+        }
+        foreach (QString workspace, workspaces) {
+            if (workspaceJobs.contains(workspace)) {
+                qWarning() << "tmpdir stress: conversions" << workspaceJobs.value(workspace) << "and" << i << "shared" << workspace;
+                allOk = false;
+            }
+            workspaceJobs.insert(workspace, i);
+        }
+    }
+    qDeleteAll(recorders);
+    qDeleteAll(jobs);
+
+    // the workspaces are deleted by the reaper thread after the conversions returned
+    QDir tmpDir(tmpRoot);
+    QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+    QElapsedTimer reaperTimer;
+    reaperTimer.start();
+    QMutex sleepMutex;
+    QWaitCondition sleepCondition;
+    while (!tmpDir.entryList(filters).isEmpty() && reaperTimer.elapsed() < iTmpDirReaperTimeout) {
+        QMutexLocker locker(&sleepMutex);
+        sleepCondition.wait(&sleepMutex, 100);
+    }
+
+    int leftovers = tmpDir.entryList(filters).count();
+    if (leftovers) {
+        qWarning() << "tmpdir stress:" << leftovers << "workspaces were not deleted from" << tmpRoot;
+        allOk = false;
+    } else {
+        QDir().rmdir(tmpRoot);
+        QDir().rmdir(runDir);
+    }
+
+    qWarning() << "tmpdir stress:" << iTmpDirStressJobs << "conversions in" << workspaceJobs.count() << "workspaces"
+               << (allOk ? "passed" : "failed");
+    return allOk;
+}
+
+UBCFFWorkspaceRecorder::UBCFFWorkspaceRecorder(UBCFFConversionJob *job, QObject *parent)
+    : QObject(parent)
+    , mJob(job)
+{}
+
+QStringList UBCFFWorkspaceRecorder::workspaces() const
+{
+    QMutexLocker locker(&mMutex);
+    return mWorkspaces;
+}
+
+void UBCFFWorkspaceRecorder::record()
+{
+    QMutexLocker locker(&mMutex);
+    foreach (QString workspace, mJob->adaptor()->workspaces())
+        if (!mWorkspaces.contains(workspace))
+            mWorkspaces.append(workspace);
+}
+
+// milliseconds, percentiles by nearest rank
+QString UBCFFBenchmark::statisticsJson(QList<qint64> samples)
+{
+    if (samples.isEmpty())
+        return "null";
+
+    QStringList values;
+    qint64 sum = 0;
+    foreach (qint64 sample, samples) {
+        values << QString::number(milliseconds(sample), 'f', 3);
+        sum += sample;
+    }
+
+    qSort(samples);
+    int count = samples.count();
+    int p90 = qMin(count - 1, qCeil(0.90*count) - 1);
+    int p99 = qMin(count - 1, qCeil(0.99*count) - 1);
+
+    return QString("{\"min\": %1, \"median\": %2, \"mean\": %3, \"p90\": %4, \"p99\": %5, \"max\": %6, \"samples\": [%7]}")
+            .arg(QString::number(milliseconds(samples.first()), 'f', 3))
+            .arg(QString::number(milliseconds(samples.at(count / 2)), 'f', 3))
+            .arg(QString::number(milliseconds(sum / count), 'f', 3))
+            .arg(QString::number(milliseconds(samples.at(qMax(0, p90))), 'f', 3))
+            .arg(QString::number(milliseconds(samples.at(qMax(0, p99))), 'f', 3))
+            .arg(QString::number(milliseconds(samples.last()), 'f', 3))
+            .arg(values.join(", "));
+}
+
+// bytes, -1 where the platform doesn't tell
+qint64 UBCFFBenchmark::peakRss()
+{
+#ifdef Q_OS_WIN
+    return -1;
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage))
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss;
+#else
+    return (qint64)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
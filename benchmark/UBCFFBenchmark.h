@@ -0,0 +1,80 @@
+#ifndef UBCFFBENCHMARK_H
+#define UBCFFBENCHMARK_H
+
+#include <QtCore>
+
+#include "UBCFFNumericCodec.h"
+#include "UBCFFSyntheticDocument.h"
+
+class UBCFFConversionJob;
+
+// A synthetic document and the options it is converted with
+struct UBCFFBenchmarkCase
+{
+    UBCFFBenchmarkCase() : directoryInput(false), compactOutput(false), precisionName("default") {}
+
+    QString name;
+    UBCFFSyntheticDocumentSpec document;
+    bool directoryInput;    // also converts the unpacked document folder once
+    bool compactOutput;
+    QString precisionName;
+    UBCFFPrecisionPolicy precision;
+};
+
+// Converts the document of a case "repeat" times after a warm-up run. Every conversion
+// is timed as a whole and per phase (unzip, parse, rasterize, pack, as measured by the
+// adaptor). Reports latency percentiles, throughput, sizes, peak RSS and the median count
+// of operator new calls per conversion as JSON.
+// A case fails if its output doesn't have as many pages as its document.
+// The suite runs every case in a process of its own, so the peak RSS is the case's
+class UBCFFBenchmark
+{
+public:
+    UBCFFBenchmark(const QString &workDir, int repeat);
+
+    static QList<UBCFFBenchmarkCase> suite(bool quick);
+    static QStringList phaseNames();
+
+    // one case in this process, its JSON object or an empty string if it failed
+    QString runCase(const UBCFFBenchmarkCase &benchmarkCase);
+    // the cases whose name contains filter, each in a child process, the whole report as JSON
+    QString runSuite(bool quick, const QString &filter);
+    // 256 conversions at once under one tmp root, true if all of them succeeded in workspaces of their own
+    bool runTmpDirStress();
+
+private:
+    bool prepareDocument(const UBCFFBenchmarkCase &benchmarkCase);
+    bool prepareDocumentDir(const UBCFFBenchmarkCase &benchmarkCase);
+    QString documentFile(const UBCFFBenchmarkCase &benchmarkCase) const;
+    QString documentDir(const UBCFFBenchmarkCase &benchmarkCase) const;
+    static int outputPageCount(const QString &iwbFile);
+    static bool checkPageCount(const UBCFFBenchmarkCase &benchmarkCase, const QString &iwbFile);
+    static QString statisticsJson(QList<qint64> samples);
+    static double milliseconds(qint64 nanoseconds) {return nanoseconds / 1000000.0;}
+    static qint64 peakRss();
+
+    QString mWorkDir;
+    int mRepeat;
+};
+
+// Records the workspaces of a job. record() is connected directly to the progress of the job,
+// so it runs in the converting thread while the workspaces exist
+class UBCFFWorkspaceRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    UBCFFWorkspaceRecorder(UBCFFConversionJob *job, QObject *parent = 0);
+
+    QStringList workspaces() const;
+
+public slots:
+    void record();
+
+private:
+    UBCFFConversionJob *mJob;
+    mutable QMutex mMutex;
+    QStringList mWorkspaces;
+};
+
+#endif // UBCFFBENCHMARK_H
@@ -0,0 +1,228 @@
+#include "UBCFFBenchmarkComparison.h"
+
+#include "UBCFFBenchmark.h"
+
+// scales the median absolute deviation to the standard deviation of normal noise
+static const double dMadToSigma = 1.4826;
+
+UBCFFBenchmarkComparison::UBCFFBenchmarkComparison(const QString &baselineDir)
+    : mBaselineDir(baselineDir)
+    , mThreshold(0.05)
+    , mMinDelta(1.0)
+    , mNoiseFactor(3.0)
+    , mAllowMissingBaselines(false)
+{}
+
+QScriptValue UBCFFBenchmarkComparison::parse(const QString &json)
+{
+    QScriptValue jsonObject = mEngine.globalObject().property("JSON");
+    QScriptValue value = jsonObject.property("parse").call(jsonObject, QScriptValueList() << json);
+    if (mEngine.hasUncaughtException() || value.isError()) {
+        qWarning() << "invalid benchmark json:" << mEngine.uncaughtException().toString();
+        mEngine.clearExceptions();
+        return QScriptValue();
+    }
+    return value;
+}
+
+QString UBCFFBenchmarkComparison::stringify(const QScriptValue &value, bool indent)
+{
+    QScriptValue jsonObject = mEngine.globalObject().property("JSON");
+    QScriptValueList arguments;
+    arguments << value;
+    if (indent)
+        arguments << QScriptValue(QScriptValue::NullValue) << QScriptValue(2);
+    return jsonObject.property("stringify").call(jsonObject, arguments).toString();
+}
+
+QString UBCFFBenchmarkComparison::baselineFile(const QString &name) const
+{
+    return mBaselineDir + "/" + name + ".json";
+}
+
+bool UBCFFBenchmarkComparison::saveBaselines(const QString &report)
+{
+    QScriptValue benchmarks = parse(report).property("benchmarks");
+    if (!benchmarks.isArray()) {
+        qWarning() << "no benchmarks in the report";
+        return false;
+    }
+    if (!QDir().mkpath(mBaselineDir)) {
+        qWarning() << "can't create baseline folder" << mBaselineDir;
+        return false;
+    }
+
+    int count = benchmarks.property("length").toInt32();
+    for (int i = 0; i < count; i++) {
+        QScriptValue benchmark = benchmarks.property(i);
+        QFile file(baselineFile(benchmark.property("name").toString()));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(stringify(benchmark, true).toUtf8() + "\n") == -1) {
+            qWarning() << "can't write baseline" << file.fileName();
+            return false;
+        }
+        qWarning() << "baseline saved to" << file.fileName();
+    }
+
+    return true;
+}
+
+UBCFFBenchmarkComparison::Result UBCFFBenchmarkComparison::compare(const QString &report, QString *summary)
+{
+    QScriptValue benchmarks = parse(report).property("benchmarks");
+    if (!benchmarks.isArray()) {
+        qWarning() << "no benchmarks in the report";
+        return NotCompared;
+    }
+
+    QString table;
+    QTextStream out(&table);
+    out << qSetFieldWidth(22) << left << "benchmark" << qSetFieldWidth(12) << "phase"
+        << qSetFieldWidth(14) << right << "baseline ms" << "current ms" << "change" << "noise ms"
+        << qSetFieldWidth(0) << "  result\n";
+
+    QStringList failures;
+    QStringList notCompared;
+    int compared = 0;
+    int count = benchmarks.property("length").toInt32();
+    for (int i = 0; i < count; i++) {
+        QScriptValue current = benchmarks.property(i);
+        QString name = current.property("name").toString();
+
+        QFile file(baselineFile(name));
+        if (!file.open(QIODevice::ReadOnly)) {
+            out << qSetFieldWidth(22) << left << name << qSetFieldWidth(0) << "no baseline, not compared\n";
+            notCompared << name;
+            continue;
+        }
+        QScriptValue baseline = parse(QString::fromUtf8(file.readAll()));
+
+        // a baseline of the quick suite says nothing about the full one
+        if (stringify(baseline.property("document")) != stringify(current.property("document"))
+            || stringify(baseline.property("options")) != stringify(current.property("options"))) {
+            out << qSetFieldWidth(22) << left << name << qSetFieldWidth(0)
+                << "baseline is of another document or options, save a new one\n";
+            notCompared << name;
+            continue;
+        }
+        compared++;
+
+        QStringList regressedPhases;
+        foreach (QString phase, UBCFFBenchmark::phaseNames()) {
+            PhaseComparison comparison = comparePhase(phase, baseline.property("phases").property(phase),
+                                                      current.property("phases").property(phase));
+            double change = comparison.baseline > 0 ? (comparison.current - comparison.baseline) / comparison.baseline : 0;
+            out << qSetFieldWidth(22) << left << name << qSetFieldWidth(12) << phase
+                << qSetFieldWidth(14) << right << fixed << qSetRealNumberPrecision(3)
+                << comparison.baseline << comparison.current
+                << QString("%1%2%").arg(change >= 0 ? "+" : "").arg(100*change, 0, 'f', 1) << comparison.noise
+                << qSetFieldWidth(0) << "  " << (comparison.regressed ? "REGRESSED" : comparison.improved ? "improved" : "ok") << "\n";
+            if (comparison.regressed)
+                regressedPhases << phase;
+        }
+
+        qint64 baselineSize = (qint64)baseline.property("outputBytes").toNumber();
+        qint64 currentSize = (qint64)current.property("outputBytes").toNumber();
+        if (currentSize > baselineSize * (1 + mThreshold)) {
+            out << qSetFieldWidth(22) << left << name << qSetFieldWidth(0)
+                << "output grew from " << baselineSize << " to " << currentSize << " bytes  REGRESSED\n";
+            regressedPhases << "output size";
+        }
+
+        // baselines saved before the allocations were counted have none
+        if (baseline.property("allocations").isNumber()) {
+            qint64 baselineAllocations = (qint64)baseline.property("allocations").toNumber();
+            qint64 currentAllocations = (qint64)current.property("allocations").toNumber();
+            if (currentAllocations > baselineAllocations * (1 + mThreshold)) {
+                out << qSetFieldWidth(22) << left << name << qSetFieldWidth(0)
+                    << "allocations grew from " << baselineAllocations << " to " << currentAllocations << "  REGRESSED\n";
+                regressedPhases << "allocations";
+            }
+        }
+
+        if (!regressedPhases.isEmpty())
+            failures << name + ": " + regressedPhases.join(", ");
+    }
+
+    Result result = Passed;
+    if (!failures.isEmpty()) {
+        out << QString("FAIL: %1 of %2 benchmarks regressed\n    %3\n").arg(failures.count()).arg(compared).arg(failures.join("\n    "));
+        result = Regressed;
+    }
+    if (0 == compared) {
+        out << "FAIL: no benchmark was compared, save the baselines first\n";
+        result = NotCompared;
+    } else if (!notCompared.isEmpty() && !mAllowMissingBaselines) {
+        out << QString("FAIL: %1 benchmarks have no usable baseline (allow it with --allow-missing-baselines)\n    %2\n")
+               .arg(notCompared.count()).arg(notCompared.join(", "));
+        if (Passed == result)
+            result = NotCompared;
+    }
+    if (Passed == result)
+        out << QString("PASS: %1 benchmarks compared, no regression\n").arg(compared);
+    out.flush();
+
+    if (summary)
+        *summary = table;
+
+    return result;
+}
+
+// Medians of the two runs, noise is the spread of both runs together. With fewer than
+// three samples in a run its spread is unknown, the thresholds alone decide then
+UBCFFBenchmarkComparison::PhaseComparison UBCFFBenchmarkComparison::comparePhase(const QString &phase, const QScriptValue &baseline, const QScriptValue &current) const
+{
+    PhaseComparison comparison;
+    comparison.phase = phase;
+
+    QList<double> baselineSamples = samples(baseline);
+    QList<double> currentSamples = samples(current);
+    comparison.baseline = median(baselineSamples);
+    comparison.current = median(currentSamples);
+
+    double baselineNoise = baselineSamples.count() >= 3 ? dMadToSigma * medianAbsoluteDeviation(baselineSamples) : 0;
+    double currentNoise = currentSamples.count() >= 3 ? dMadToSigma * medianAbsoluteDeviation(currentSamples) : 0;
+    comparison.noise = qSqrt(baselineNoise*baselineNoise + currentNoise*currentNoise);
+
+    double margin = qMax(qMax(mThreshold * comparison.baseline, mMinDelta), mNoiseFactor * comparison.noise);
+    double delta = comparison.current - comparison.baseline;
+    comparison.regressed = delta > margin;
+    comparison.improved = -delta > margin;
+
+    return comparison;
+}
+
+QList<double> UBCFFBenchmarkComparison::samples(const QScriptValue &statistics)
+{
+    QList<double> values;
+    QScriptValue sampleArray = statistics.property("samples");
+    int count = sampleArray.property("length").toInt32();
+    for (int i = 0; i < count; i++)
+        values << sampleArray.property(i).toNumber();
+
+    // reports without the samples still have their median
+    if (values.isEmpty() && statistics.property("median").isNumber())
+        values << statistics.property("median").toNumber();
+
+    return values;
+}
+
+double UBCFFBenchmarkComparison::median(QList<double> values)
+{
+    if (values.isEmpty())
+        return 0;
+
+    qSort(values);
+    int middle = values.count() / 2;
+    return values.count() % 2 ? values.at(middle) : (values.at(middle - 1) + values.at(middle)) / 2;
+}
+
+double UBCFFBenchmarkComparison::medianAbsoluteDeviation(const QList<double> &values)
+{
+    double center = median(values);
+    QList<double> deviations;
+    foreach (double value, values)
+        deviations << qAbs(value - center);
+
+    return median(deviations);
+}
@@ -0,0 +1,64 @@
+#ifndef UBCFFBENCHMARKCOMPARISON_H
+#define UBCFFBENCHMARKCOMPARISON_H
+
+#include <QtCore>
+#include <QtScript>
+
+// Regression gate on top of the benchmark reports. A baseline is kept per benchmark, as
+// <baseline dir>/<name>.json holding the benchmark's object of the report it was saved from.
+// A phase regressed when its median grew by more than the relative threshold, by more than
+// minDelta milliseconds and by more than noiseFactor times the noise of the two runs,
+// estimated from the median absolute deviation of their samples. Output size and the count
+// of allocations are compared against the relative threshold.
+// A run that compares nothing, or has benchmarks without a usable baseline, doesn't pass
+class UBCFFBenchmarkComparison
+{
+public:
+    enum Result
+    {
+        Passed,
+        Regressed,
+        NotCompared // unreadable report, nothing compared or missing baselines
+    };
+
+    UBCFFBenchmarkComparison(const QString &baselineDir);
+
+    void setThreshold(double threshold) {mThreshold = threshold;}           // relative, 0.05 is 5%
+    void setMinDelta(double minDelta) {mMinDelta = minDelta;}               // milliseconds
+    void setNoiseFactor(double noiseFactor) {mNoiseFactor = noiseFactor;}
+    // benchmarks without a usable baseline are skipped instead of failing the run
+    void setAllowMissingBaselines(bool allow) {mAllowMissingBaselines = allow;}
+
+    bool saveBaselines(const QString &report);
+    // the table of all the comparisons goes to summary
+    Result compare(const QString &report, QString *summary);
+
+private:
+    struct PhaseComparison
+    {
+        QString phase;
+        double baseline;
+        double current;
+        double noise;
+        bool regressed;
+        bool improved;
+    };
+
+    QScriptValue parse(const QString &json);
+    QString stringify(const QScriptValue &value, bool indent = false);
+    QString baselineFile(const QString &name) const;
+
+    PhaseComparison comparePhase(const QString &phase, const QScriptValue &baseline, const QScriptValue &current) const;
+    static QList<double> samples(const QScriptValue &statistics);
+    static double median(QList<double> values);
+    static double medianAbsoluteDeviation(const QList<double> &values);
+
+    QString mBaselineDir;
+    double mThreshold;
+    double mMinDelta;
+    double mNoiseFactor;
+    bool mAllowMissingBaselines;
+    QScriptEngine mEngine;
+};
+
+#endif // UBCFFBENCHMARKCOMPARISON_H
@@ -0,0 +1,406 @@
+#include "UBCFFSyntheticDocument.h"
+
+#include <QImage>
+#include <QTextDocument>
+
+#include "UBGlobals.h"
+
+THIRD_PARTY_WARNINGS_DISABLE
+#include "quazip.h"
+#include "quazipfile.h"
+THIRD_PARTY_WARNINGS_ENABLE
+
+static const int iPageWidth = 1280;
+static const int iPageHeight = 960;
+static const qint64 iRandomEntryChunkSize = 1024*1024;
+
+static const char *sLoremIpsum[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna"
+};
+
+UBCFFSyntheticDocumentSpec::UBCFFSyntheticDocumentSpec()
+    : pages(10)
+    , strokesPerPage(20)
+    , segmentsPerStroke(30)
+    , polygonPoints(26)
+    , linesPerPage(0)
+    , textsPerPage(2)
+    , imagesPerPage(1)
+    , imageSize(640, 480)
+    , svgImagesPerPage(0)
+    , videos(0)
+    , videoSize(1024*1024)
+    , audios(0)
+    , audioSize(512*1024)
+    , widgets(0)
+    , seed(1)
+{}
+
+QStringList UBCFFSyntheticDocumentSpec::toArguments() const
+{
+    return QStringList() << "--pages" << QString::number(pages)
+                         << "--strokes" << QString::number(strokesPerPage)
+                         << "--segments" << QString::number(segmentsPerStroke)
+                         << "--points" << QString::number(polygonPoints)
+                         << "--lines" << QString::number(linesPerPage)
+                         << "--texts" << QString::number(textsPerPage)
+                         << "--images" << QString::number(imagesPerPage)
+                         << "--image-size" << QString("%1x%2").arg(imageSize.width()).arg(imageSize.height())
+                         << "--svg-images" << QString::number(svgImagesPerPage)
+                         << "--videos" << QString::number(videos)
+                         << "--video-size" << QString::number(videoSize)
+                         << "--audios" << QString::number(audios)
+                         << "--audio-size" << QString::number(audioSize)
+                         << "--widgets" << QString::number(widgets)
+                         << "--seed" << QString::number(seed);
+}
+
+QString UBCFFSyntheticDocumentSpec::toJson() const
+{
+    return QString("{\"pages\": %1, \"strokesPerPage\": %2, \"segmentsPerStroke\": %3, \"polygonPoints\": %4, "
+                   "\"linesPerPage\": %5, \"textsPerPage\": %6, \"imagesPerPage\": %7, \"imageSize\": \"%8x%9\", "
+                   "\"svgImagesPerPage\": %10, \"videos\": %11, \"videoSize\": %12, \"audios\": %13, "
+                   "\"audioSize\": %14, \"widgets\": %15, \"seed\": %16}")
+            .arg(pages).arg(strokesPerPage).arg(segmentsPerStroke).arg(polygonPoints)
+            .arg(linesPerPage).arg(textsPerPage).arg(imagesPerPage).arg(imageSize.width()).arg(imageSize.height())
+            .arg(svgImagesPerPage).arg(videos).arg(videoSize).arg(audios)
+            .arg(audioSize).arg(widgets).arg(seed);
+}
+
+UBCFFSyntheticDocument::UBCFFSyntheticDocument(const UBCFFSyntheticDocumentSpec &spec)
+    : mSpec(spec)
+    , mRandomState(spec.seed ? spec.seed : 1)
+    , mZip(NULL)
+{}
+
+bool UBCFFSyntheticDocument::parseArguments(const QStringList &arguments, UBCFFSyntheticDocumentSpec &spec)
+{
+    for (int i = 0; i + 1 < arguments.count(); i++) {
+        QString option = arguments.at(i);
+        QString value = arguments.at(i + 1);
+        bool ok = true;
+
+        if      (option == "--pages")      spec.pages = value.toInt(&ok);
+        else if (option == "--strokes")    spec.strokesPerPage = value.toInt(&ok);
+        else if (option == "--segments")   spec.segmentsPerStroke = value.toInt(&ok);
+        else if (option == "--points")     spec.polygonPoints = value.toInt(&ok);
+        else if (option == "--lines")      spec.linesPerPage = value.toInt(&ok);
+        else if (option == "--texts")      spec.textsPerPage = value.toInt(&ok);
+        else if (option == "--images")     spec.imagesPerPage = value.toInt(&ok);
+        else if (option == "--svg-images") spec.svgImagesPerPage = value.toInt(&ok);
+        else if (option == "--videos")     spec.videos = value.toInt(&ok);
+        else if (option == "--video-size") spec.videoSize = value.toLongLong(&ok);
+        else if (option == "--audios")     spec.audios = value.toInt(&ok);
+        else if (option == "--audio-size") spec.audioSize = value.toLongLong(&ok);
+        else if (option == "--widgets")    spec.widgets = value.toInt(&ok);
+        else if (option == "--seed")       spec.seed = value.toUInt(&ok);
+        else if (option == "--image-size") {
+            QStringList size = value.split("x");
+            bool widthOk = false, heightOk = false;
+            if (2 == size.count())
+                spec.imageSize = QSize(size.at(0).toInt(&widthOk), size.at(1).toInt(&heightOk));
+            ok = widthOk && heightOk && !spec.imageSize.isEmpty();
+        }
+        else continue;
+
+        if (!ok) {
+            qWarning() << "invalid value" << value << "of" << option;
+            return false;
+        }
+        i++;
+    }
+
+    return 0 < spec.pages;
+}
+
+bool UBCFFSyntheticDocument::write(const QString &ubzFile)
+{
+    mRandomState = mSpec.seed ? mSpec.seed : 1;
+    mVideoFiles.clear();
+    mAudioFiles.clear();
+    mWidgetFiles.clear();
+
+    QuaZip zip(ubzFile);
+    if (!zip.open(QuaZip::mdCreate)) {
+        qWarning() << "can't create" << ubzFile << zip.getZipError();
+        return false;
+    }
+    mZip = &zip;
+
+    bool written = addEntry(&zip, "metadata.rdf", metadata());
+
+    // media files first, the pages refer to them
+    for (int i = 0; written && i < mSpec.videos; i++) {
+        mVideoFiles << "videos/" + nextUuid() + ".mpg";
+        written = addRandomEntry(&zip, mVideoFiles.last(), mSpec.videoSize);
+    }
+    for (int i = 0; written && i < mSpec.audios; i++) {
+        mAudioFiles << "audios/" + nextUuid() + ".mp3";
+        written = addRandomEntry(&zip, mAudioFiles.last(), mSpec.audioSize);
+    }
+    for (int i = 0; written && i < mSpec.widgets; i++) {
+        QString uuid = nextUuid();
+        QString bundle = "widgets/" + uuid + ".wgt";
+        mWidgetFiles << bundle;
+        written = addEntry(&zip, bundle + "/config.xml",
+                           QString("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                   "<widget xmlns=\"http://www.w3.org/ns/widgets\" id=\"%1\" width=\"400\" height=\"300\">\n"
+                                   "    <name>Synthetic widget</name>\n"
+                                   "    <content src=\"index.html\"/>\n"
+                                   "</widget>\n").arg(uuid).toUtf8())
+               && addEntry(&zip, bundle + "/index.html", "<html><body><p>synthetic widget</p></body></html>\n")
+               && addEntry(&zip, "widgets/" + QString(uuid).remove("{").remove("}") + ".png", pngImage(), false);
+    }
+
+    // the images of a page are added before the page itself
+    for (int i = 1; written && i <= mSpec.pages; i++) {
+        QByteArray pageData = page(i);
+        written = !pageData.isEmpty() && addEntry(&zip, QString("page%1.svg").arg(i, 3, 10, QChar('0')), pageData);
+    }
+
+    mZip = NULL;
+    zip.close();
+    if (!written || zip.getZipError() != ZIP_OK) {
+        qWarning() << "can't write" << ubzFile << zip.getZipError();
+        QFile::remove(ubzFile);
+        return false;
+    }
+
+    return true;
+}
+
+QString UBCFFSyntheticDocument::nextUuid()
+{
+    quint32 first = nextRandom();
+    quint32 second = nextRandom();
+    quint32 third = nextRandom();
+    quint32 fourth = nextRandom();
+
+    return QString("{%1-%2-4%3-%4-%5%6}").arg(first, 8, 16, QChar('0'))
+                                         .arg(second >> 16, 4, 16, QChar('0'))
+                                         .arg(second & 0xfff, 3, 16, QChar('0'))
+                                         .arg(0x8000 | (third >> 18), 4, 16, QChar('0'))
+                                         .arg(third & 0xffff, 4, 16, QChar('0'))
+                                         .arg(fourth, 8, 16, QChar('0'));
+}
+
+// xorshift, the documents don't depend on the platform's rand()
+quint32 UBCFFSyntheticDocument::nextRandom()
+{
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return mRandomState;
+}
+
+qreal UBCFFSyntheticDocument::nextCoordinate(qreal range)
+{
+    return range * (nextRandom() / 4294967296.0) - range / 2;
+}
+
+QByteArray UBCFFSyntheticDocument::randomData(int size)
+{
+    QByteArray data(size, '\0');
+    for (int i = 0; i < size; i += 4) {
+        quint32 value = nextRandom();
+        for (int j = 0; j < 4 && i + j < size; j++)
+            data[i + j] = (char)(value >> (8*j));
+    }
+    return data;
+}
+
+QByteArray UBCFFSyntheticDocument::metadata() const
+{
+    return QString("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                   "<RDF xmlns=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\" xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:ub=\"http://uniboard.mnemis.com/document\">\n"
+                   "    <Description about=\"http://uniboard.mnemis.com/document/synthetic\">\n"
+                   "        <dc:title>Synthetic document</dc:title>\n"
+                   "        <dc:format>image/svg+xml</dc:format>\n"
+                   "        <ub:version>4.5.0</ub:version>\n"
+                   "        <ub:size>%1x%2</ub:size>\n"
+                   "        <ub:pageCount>%3</ub:pageCount>\n"
+                   "    </Description>\n"
+                   "</RDF>\n").arg(iPageWidth).arg(iPageHeight).arg(mSpec.pages).toUtf8();
+}
+
+// The page svg, its images are added to the archive on the way. Empty if one couldn't be
+QByteArray UBCFFSyntheticDocument::page(int pageNumber)
+{
+    QString svg;
+    svg += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    svg += QString("<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" "
+                   "xmlns:ub=\"http://uniboard.mnemis.com/document\" xmlns:xhtml=\"http://www.w3.org/1999/xhtml\" "
+                   "version=\"1.1\" ub:version=\"4.5.0\" ub:uuid=\"%1\" viewBox=\"%2 %3 %4 %5\" ub:nominal-size=\"%4x%5\" "
+                   "ub:dark-background=\"false\" ub:crossed-background=\"false\">\n")
+            .arg(QString(nextUuid()).remove("{").remove("}"))
+            .arg(-iPageWidth/2).arg(-iPageHeight/2).arg(iPageWidth).arg(iPageHeight);
+    svg += QString("<rect fill=\"white\" x=\"%1\" y=\"%2\" width=\"%3\" height=\"%4\"/>\n")
+            .arg(-iPageWidth/2).arg(-iPageHeight/2).arg(iPageWidth).arg(iPageHeight);
+
+    int zValue = 1;
+    QString mediaElement("<%1 xlink:href=\"%2\" x=\"0\" y=\"0\" width=\"%3\" height=\"%4\" "
+                         "transform=\"matrix(1, 0, 0, 1, %5, %6)\" ub:z-value=\"%7\" ub:uuid=\"%8\" ub:layer=\"-1000\"/>\n");
+
+    for (int i = 0; i < mSpec.imagesPerPage; i++) {
+        QString imageFile = "images/" + nextUuid() + ".png";
+        if (!addEntry(mZip, imageFile, pngImage(), false))
+            return QByteArray();
+        svg += mediaElement.arg("image").arg(imageFile).arg(mSpec.imageSize.width()).arg(mSpec.imageSize.height())
+                           .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                           .arg(zValue++).arg(QString(nextUuid()).remove("{").remove("}"));
+    }
+    for (int i = 0; i < mSpec.svgImagesPerPage; i++) {
+        QString imageFile = "images/" + nextUuid() + ".svg";
+        if (!addEntry(mZip, imageFile, svgImage()))
+            return QByteArray();
+        svg += mediaElement.arg("image").arg(imageFile).arg(200).arg(200)
+                           .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                           .arg(zValue++).arg(QString(nextUuid()).remove("{").remove("}"));
+    }
+    for (int i = pageNumber - 1; i < mVideoFiles.count(); i += mSpec.pages)
+        svg += mediaElement.arg("video").arg(mVideoFiles.at(i)).arg(320).arg(240)
+                           .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                           .arg(zValue++).arg(QString(nextUuid()).remove("{").remove("}"));
+    for (int i = pageNumber - 1; i < mAudioFiles.count(); i += mSpec.pages)
+        svg += mediaElement.arg("audio").arg(mAudioFiles.at(i)).arg(100).arg(100)
+                           .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                           .arg(zValue++).arg(QString(nextUuid()).remove("{").remove("}"));
+    for (int i = pageNumber - 1; i < mWidgetFiles.count(); i += mSpec.pages)
+        svg += QString("<foreignObject ub:src=\"%1\" x=\"0\" y=\"0\" width=\"400\" height=\"300\" "
+                       "transform=\"matrix(1, 0, 0, 1, %2, %3)\" ub:z-value=\"%4\" ub:background=\"false\" "
+                       "ub:uuid=\"%5\" ub:layer=\"-1000\"/>\n")
+                .arg(mWidgetFiles.at(i))
+                .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                .arg(zValue++).arg(QString(mWidgetFiles.at(i)).remove("widgets/").remove(".wgt").remove("{").remove("}"));
+
+    for (int i = 0; i < mSpec.textsPerPage; i++)
+        svg += textBlock(zValue++);
+    for (int i = 0; i < mSpec.strokesPerPage; i++)
+        svg += stroke(zValue++);
+    for (int i = 0; i < mSpec.linesPerPage; i++)
+        svg += QString("<line x1=\"%1\" y1=\"%2\" x2=\"%3\" y2=\"%4\" stroke-width=\"3\" stroke=\"#0000ff\" "
+                       "stroke-opacity=\"1\" stroke-linecap=\"round\" ub:z-value=\"%5\"/>\n")
+                .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+                .arg(zValue++);
+
+    svg += "</svg>\n";
+
+    return svg.toUtf8();
+}
+
+// a gradient with noise, deflates about as badly as a photo
+QByteArray UBCFFSyntheticDocument::pngImage()
+{
+    QImage image(mSpec.imageSize, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); y++) {
+        QRgb *line = (QRgb*)image.scanLine(y);
+        for (int x = 0; x < image.width(); x++) {
+            quint32 noise = nextRandom();
+            line[x] = qRgb((x + (noise & 0x1f)) & 0xff, (y + ((noise >> 8) & 0x1f)) & 0xff, ((x ^ y) + ((noise >> 16) & 0x1f)) & 0xff);
+        }
+    }
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return data;
+}
+
+QByteArray UBCFFSyntheticDocument::svgImage()
+{
+    QString svg("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"200\" height=\"200\" viewBox=\"0 0 200 200\">\n");
+    for (int i = 0; i < 20; i++)
+        svg += QString("<circle cx=\"%1\" cy=\"%2\" r=\"%3\" fill=\"#%4\" fill-opacity=\"0.6\" stroke=\"#000000\"/>\n")
+                .arg(100 + nextCoordinate(200), 0, 'f', 2).arg(100 + nextCoordinate(200), 0, 'f', 2)
+                .arg(10 + qAbs(nextCoordinate(60)), 0, 'f', 2).arg(nextRandom() & 0xffffff, 6, 16, QChar('0'));
+    svg += "</svg>\n";
+
+    return svg.toUtf8();
+}
+
+// A pen stroke as the board saves it: a random walk, every segment is a polygon
+// going around the segment with round ends, all in a group of the stroke color
+QString UBCFFSyntheticDocument::stroke(int zValue)
+{
+    QString color = QString("#%1").arg(nextRandom() & 0xffffff, 6, 16, QChar('0'));
+    qreal radius = 1 + qAbs(nextCoordinate(8));
+    int halfPoints = qMax(2, mSpec.polygonPoints / 2);
+
+    QString result = QString("<g ub:z-value=\"%1\" ub:fill-on-dark-background=\"%2\" ub:fill-on-light-background=\"%2\">\n")
+                     .arg(zValue).arg(color);
+
+    QPointF point(nextCoordinate(iPageWidth), nextCoordinate(iPageHeight));
+    for (int i = 0; i < mSpec.segmentsPerStroke; i++) {
+        QPointF next = point + QPointF(nextCoordinate(20), nextCoordinate(20));
+        qreal angle = qAtan2(next.y() - point.y(), next.x() - point.x());
+
+        QString points;
+        for (int k = 0; k < halfPoints; k++) {
+            qreal a = angle + M_PI/2 + M_PI*k/(halfPoints - 1);
+            points += QString("%1,%2 ").arg(point.x() + radius*qCos(a), 0, 'f', 2).arg(point.y() + radius*qSin(a), 0, 'f', 2);
+        }
+        for (int k = 0; k < halfPoints; k++) {
+            qreal a = angle - M_PI/2 + M_PI*k/(halfPoints - 1);
+            points += QString("%1,%2 ").arg(next.x() + radius*qCos(a), 0, 'f', 2).arg(next.y() + radius*qSin(a), 0, 'f', 2);
+        }
+
+        result += QString("<polygon points=\"%1\" fill=\"%2\" fill-opacity=\"1.00\" stroke=\"%2\" stroke-width=\"1\" "
+                          "stroke-opacity=\"0.10\" fill-rule=\"evenodd\"/>\n").arg(points).arg(color);
+        point = next;
+    }
+
+    result += "</g>\n";
+    return result;
+}
+
+QString UBCFFSyntheticDocument::textBlock(int zValue)
+{
+    QString words;
+    int wordCount = 10 + nextRandom() % 40;
+    for (int i = 0; i < wordCount; i++)
+        words += QString(i ? " " : "") + sLoremIpsum[nextRandom() % (sizeof(sLoremIpsum)/sizeof(sLoremIpsum[0]))];
+
+    QString html = QString("<html><head></head><body style=\" font-family:'Arial'; font-size:20pt; font-weight:400; font-style:normal;\">"
+                           "<p style=\" margin-top:0px; margin-bottom:0px;\"><span style=\" font-size:20pt; color:#%1;\">%2</span></p>"
+                           "</body></html>").arg(nextRandom() & 0xffffff, 6, 16, QChar('0')).arg(words);
+
+    return QString("<foreignObject ub:type=\"text\" x=\"0\" y=\"0\" width=\"400\" height=\"120\" "
+                   "transform=\"matrix(1, 0, 0, 1, %1, %2)\" ub:z-value=\"%3\" ub:uuid=\"%4\" ub:layer=\"0\">"
+                   "<ub:itemTextContent>%5</ub:itemTextContent></foreignObject>\n")
+            .arg(nextCoordinate(iPageWidth), 0, 'f', 2).arg(nextCoordinate(iPageHeight), 0, 'f', 2)
+            .arg(zValue).arg(QString(nextUuid()).remove("{").remove("}")).arg(Qt::escape(html));
+}
+
+bool UBCFFSyntheticDocument::addEntry(QuaZip *zip, const QString &name, const QByteArray &data, bool deflate)
+{
+    QuaZipFile file(zip);
+    if (!file.open(QIODevice::WriteOnly, QuaZipNewInfo(name), NULL, 0, deflate ? Z_DEFLATED : 0)) {
+        qWarning() << "can't add" << name << file.getZipError();
+        return false;
+    }
+    file.write(data);
+    file.close();
+
+    return file.getZipError() == ZIP_OK;
+}
+
+// videos and audios are random bytes, the converter copies them as they are
+bool UBCFFSyntheticDocument::addRandomEntry(QuaZip *zip, const QString &name, qint64 size)
+{
+    QuaZipNewInfo info(name);
+    info.uncompressedSize = (quint64)size;
+    QuaZipFile file(zip);
+    if (!file.open(QIODevice::WriteOnly, info, NULL, 0, 0)) {
+        qWarning() << "can't add" << name << file.getZipError();
+        return false;
+    }
+    for (qint64 written = 0; written < size; written += iRandomEntryChunkSize)
+        file.write(randomData((int)qMin(iRandomEntryChunkSize, size - written)));
+    file.close();
+
+    return file.getZipError() == ZIP_OK;
+}
@@ -0,0 +1,70 @@
+#ifndef UBCFFSYNTHETICDOCUMENT_H
+#define UBCFFSYNTHETICDOCUMENT_H
+
+#include <QtCore>
+
+class QuaZip;
+
+// What a generated ubz document is made of. Counts ending with PerPage are repeated on
+// every page, videos, audios and widgets are spread over the pages.
+// A stroke is drawn the way the board stores it: a group of one polygon per segment
+struct UBCFFSyntheticDocumentSpec
+{
+    UBCFFSyntheticDocumentSpec();
+
+    QStringList toArguments() const;
+    QString toJson() const;
+
+    int pages;
+    int strokesPerPage;
+    int segmentsPerStroke;
+    int polygonPoints;      // points of every segment polygon
+    int linesPerPage;
+    int textsPerPage;
+    int imagesPerPage;      // png images, already compressed
+    QSize imageSize;
+    int svgImagesPerPage;   // svg images, rendered to png by the converter
+    int videos;
+    qint64 videoSize;       // bytes
+    int audios;
+    qint64 audioSize;       // bytes
+    int widgets;
+    quint32 seed;
+};
+
+// Writes a synthetic ubz document. The same spec always gives the same document
+class UBCFFSyntheticDocument
+{
+public:
+    UBCFFSyntheticDocument(const UBCFFSyntheticDocumentSpec &spec);
+
+    bool write(const QString &ubzFile);
+
+    // --pages n --strokes n ... as printed by UBCFFSyntheticDocumentSpec::toArguments()
+    static bool parseArguments(const QStringList &arguments, UBCFFSyntheticDocumentSpec &spec);
+
+private:
+    QString nextUuid();
+    quint32 nextRandom();
+    qreal nextCoordinate(qreal range);
+    QByteArray randomData(int size);
+
+    QByteArray metadata() const;
+    QByteArray page(int pageNumber);
+    QByteArray pngImage();
+    QByteArray svgImage();
+    QString stroke(int zValue);
+    QString textBlock(int zValue);
+
+    bool addEntry(QuaZip *zip, const QString &name, const QByteArray &data, bool deflate = true);
+    bool addRandomEntry(QuaZip *zip, const QString &name, qint64 size);
+
+    UBCFFSyntheticDocumentSpec mSpec;
+    quint32 mRandomState;
+    QuaZip *mZip;
+    QStringList mVideoFiles;
+    QStringList mAudioFiles;
+    QStringList mWidgetFiles;
+};
+
+#endif // UBCFFSYNTHETICDOCUMENT_H
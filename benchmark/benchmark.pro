@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Conversion benchmarks on synthetic ubz documents
+#
+#-------------------------------------------------
+
+QT       += core gui xml svg script
+TARGET = benchmark
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+QUAZIP_DIR   = "$$PWD/../quazip"
+
+INCLUDEPATH += "../UBCFFAdaptor/src" \
+               "$$QUAZIP_DIR/quazip-0.3" \
+               "$$PWD/../zlib/1.2.3/include"
+
+DEFINES += NO_THIRD_PARTY_WARNINGS
+
+win32:        LIBS += "-L../UBCFFAdaptor/lib/win32" "-lCFF_Adaptor" "-L$$QUAZIP_DIR/lib/win32" "-lquazip"
+linux-g++-32: LIBS += "-L../UBCFFAdaptor/lib/linux" "-lCFF_Adaptor" "-L$$QUAZIP_DIR/lib/linux" "-lquazip"
+linux-g++-64: LIBS += "-L../UBCFFAdaptor/lib/linux" "-lCFF_Adaptor" "-L$$QUAZIP_DIR/lib/linux" "-lquazip"
+linux-g++:    LIBS += "-L../UBCFFAdaptor/lib/linux" "-lCFF_Adaptor" "-L$$QUAZIP_DIR/lib/linux" "-lquazip"
+macx:         LIBS += "-L../UBCFFAdaptor/lib/mac"   "-lCFF_Adaptor" "-L$$QUAZIP_DIR/lib/macx"  "-lquazip"
+
+SOURCES += main.cpp \
+    UBCFFAllocationCounter.cpp \
+    UBCFFBenchmark.cpp \
+    UBCFFBenchmarkComparison.cpp \
+    UBCFFSyntheticDocument.cpp
+
+HEADERS += UBCFFAllocationCounter.h \
+    UBCFFBenchmark.h \
+    UBCFFBenchmarkComparison.h \
+    UBCFFSyntheticDocument.h
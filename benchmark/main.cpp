@@ -0,0 +1,155 @@
+#include <QtCore/QCoreApplication>
+#include <QtCore>
+#include "UBCFFBenchmark.h"
+#include "UBCFFBenchmarkComparison.h"
+#include "UBCFFSyntheticDocument.h"
+
+static bool verbose = false;
+
+static QString readReport(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "can't read benchmark report" << fileName;
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+// the converter logs every page and element, writing that to the console would be timed too
+static void messageHandler(QtMsgType type, const char *message)
+{
+    if (QtDebugMsg == type && !verbose)
+        return;
+    fprintf(stderr, "%s\n", message);
+    if (QtFatalMsg == type)
+        abort();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    verbose = args.contains("--verbose");
+    qInstallMsgHandler(messageHandler);
+
+    // benchmark --generate <file.ubz> [--pages n] [--strokes n] [--segments n] [--points n] [--lines n]
+    //           [--texts n] [--images n] [--image-size WxH] [--svg-images n] [--videos n] [--video-size bytes]
+    //           [--audios n] [--audio-size bytes] [--widgets n] [--seed n]
+    int generateArg = args.indexOf("--generate");
+    if (generateArg != -1) {
+        QString ubzFile = args.value(generateArg + 1);
+        UBCFFSyntheticDocumentSpec spec;
+        if (ubzFile.isEmpty() || !UBCFFSyntheticDocument::parseArguments(args, spec)) {
+            qWarning() << "usage: benchmark --generate <file.ubz>" << spec.toArguments().join(" ");
+            return 1;
+        }
+
+        UBCFFSyntheticDocument document(spec);
+        return document.write(ubzFile) ? 0 : 1;
+    }
+
+    bool quick = args.contains("--quick");
+    int repeatArg = args.indexOf("--repeat");
+    int repeat = repeatArg != -1 ? args.value(repeatArg + 1).toInt() : 5;
+    int workArg = args.indexOf("--work");
+    QString workDir = workArg != -1 ? args.value(workArg + 1) : QDir::tempPath() + "/CFF_adaptor_benchmark";
+    UBCFFBenchmark benchmark(workDir, repeat);
+
+    if (args.contains("--list")) {
+        foreach (UBCFFBenchmarkCase benchmarkCase, UBCFFBenchmark::suite(quick))
+            printf("%s\t%s\n", qPrintable(benchmarkCase.name), qPrintable(benchmarkCase.document.toArguments().join(" ")));
+        printf("tmpdir-stress\t256 conversions at once, not timed and not in the suite\n");
+        return 0;
+    }
+
+    // benchmark --case <name>: one case in this process, its json to stdout. The suite runs its cases so
+    // benchmark --case tmpdir-stress: the temporary workspace stress check, exits with 1 if it failed
+    int caseArg = args.indexOf("--case");
+    if (caseArg != -1 && "tmpdir-stress" == args.value(caseArg + 1))
+        return benchmark.runTmpDirStress() ? 0 : 1;
+    if (caseArg != -1) {
+        foreach (UBCFFBenchmarkCase benchmarkCase, UBCFFBenchmark::suite(quick)) {
+            if (benchmarkCase.name != args.value(caseArg + 1))
+                continue;
+            QString result = benchmark.runCase(benchmarkCase);
+            if (result.isEmpty())
+                return 1;
+            printf("%s\n", result.toUtf8().constData());
+            return 0;
+        }
+        qWarning() << "unknown benchmark" << args.value(caseArg + 1) << ", see benchmark --list";
+        return 1;
+    }
+
+    // Regression gate, the baselines are kept per benchmark in <work dir>/baselines by default:
+    //   benchmark --save-baseline <results.json> [--baselines <dir>]
+    //   benchmark --compare <results.json> [--baselines <dir>] [--threshold <percent>] [--min-delta <ms>] [--noise-factor <k>]
+    //                       [--allow-missing-baselines]
+    //   benchmark --gate [suite options] [comparison options]   runs the suite and compares it
+    // --compare and --gate exit with 1 if anything regressed, 2 on errors, when nothing was compared
+    // or when a benchmark has no usable baseline and --allow-missing-baselines isn't given
+    int baselinesArg = args.indexOf("--baselines");
+    UBCFFBenchmarkComparison comparison(baselinesArg != -1 ? args.value(baselinesArg + 1) : workDir + "/baselines");
+    int thresholdArg = args.indexOf("--threshold");
+    if (thresholdArg != -1)
+        comparison.setThreshold(args.value(thresholdArg + 1).toDouble() / 100);
+    int minDeltaArg = args.indexOf("--min-delta");
+    if (minDeltaArg != -1)
+        comparison.setMinDelta(args.value(minDeltaArg + 1).toDouble());
+    int noiseFactorArg = args.indexOf("--noise-factor");
+    if (noiseFactorArg != -1)
+        comparison.setNoiseFactor(args.value(noiseFactorArg + 1).toDouble());
+    comparison.setAllowMissingBaselines(args.contains("--allow-missing-baselines"));
+
+    int saveBaselineArg = args.indexOf("--save-baseline");
+    if (saveBaselineArg != -1) {
+        QString report = readReport(args.value(saveBaselineArg + 1));
+        return !report.isEmpty() && comparison.saveBaselines(report) ? 0 : 1;
+    }
+
+    int compareArg = args.indexOf("--compare");
+    if (compareArg != -1) {
+        QString report = readReport(args.value(compareArg + 1));
+        if (report.isEmpty())
+            return 2;
+        QString summary;
+        UBCFFBenchmarkComparison::Result result = comparison.compare(report, &summary);
+        printf("%s", summary.toUtf8().constData());
+        return UBCFFBenchmarkComparison::Passed == result ? 0 : UBCFFBenchmarkComparison::Regressed == result ? 1 : 2;
+    }
+
+    // benchmark [--quick] [--repeat <n>] [--filter <text>] [--work <dir>] [--output <results.json>] [--verbose]
+    int filterArg = args.indexOf("--filter");
+    QString filter = filterArg != -1 ? args.value(filterArg + 1) : QString();
+    QString report = benchmark.runSuite(quick, filter);
+    if (report.isEmpty())
+        return args.contains("--gate") ? 2 : 1;
+
+    int outputArg = args.indexOf("--output");
+    if (args.contains("--gate")) {
+        if (outputArg != -1) {
+            QFile output(args.value(outputArg + 1));
+            if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(report.toUtf8()) == -1)
+                qWarning() << "can't write" << output.fileName();
+        }
+        QString summary;
+        UBCFFBenchmarkComparison::Result result = comparison.compare(report, &summary);
+        printf("%s", summary.toUtf8().constData());
+        return UBCFFBenchmarkComparison::Passed == result ? 0 : UBCFFBenchmarkComparison::Regressed == result ? 1 : 2;
+    }
+
+    if (outputArg == -1) {
+        printf("%s", report.toUtf8().constData());
+        return 0;
+    }
+
+    QFile output(args.value(outputArg + 1));
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(report.toUtf8()) == -1) {
+        qWarning() << "can't write" << output.fileName();
+        return 1;
+    }
+
+    return 0;
+}
@@ -3,5 +3,6 @@ TEMPLATE = subdirs
 SUBDIRS = \
      quazip\
      UBCFFAdaptor\
-     launcherApp
+     launcherApp\
+     benchmark
 CONFIG += ordered
@@ -0,0 +1,201 @@
+#include "UBCFFDaemon.h"
+
+#include "UBCFFConversionJob.h"
+
+UBCFFDaemon::UBCFFDaemon(int workers, const QString &documentCacheDir, const QString &tmpRoot, QObject *parent)
+    : QObject(parent)
+    , mDocumentCacheDir(documentCacheDir)
+    , mTmpRoot(tmpRoot)
+    , mDoneCount(0)
+    , mFailedCount(0)
+{
+    mWorkers.setMaxThreadCount(workers > 0 ? workers : QThread::idealThreadCount());
+    connect(&mServer, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+UBCFFDaemon::~UBCFFDaemon()
+{
+    foreach (UBCFFConversionJob *job, mJobs.keys())
+        job->cancel();
+    mWorkers.waitForDone();
+    qDeleteAll(mJobs.keys());
+}
+
+bool UBCFFDaemon::listen(const QString &socketName)
+{
+    // a socket file left by a crashed daemon would make listen() fail
+    QLocalServer::removeServer(socketName);
+    if (!mServer.listen(socketName)) {
+        qDebug() << "can't listen on" << socketName << ":" << mServer.errorString();
+        return false;
+    }
+
+    qDebug() << "conversion daemon is listening on" << mServer.fullServerName() << "with" << mWorkers.maxThreadCount() << "workers";
+    return true;
+}
+
+void UBCFFDaemon::onNewConnection()
+{
+    while (QLocalSocket *client = mServer.nextPendingConnection()) {
+        connect(client, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(client, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    }
+}
+
+void UBCFFDaemon::onReadyRead()
+{
+    QLocalSocket *client = qobject_cast<QLocalSocket*>(sender());
+    if (!client)
+        return;
+
+    while (client->canReadLine()) {
+        QString request = QString::fromUtf8(client->readLine()).trimmed();
+        if (!request.isEmpty())
+            processRequest(client, request);
+    }
+}
+
+// jobs of a client that went away are not needed by anyone
+void UBCFFDaemon::onDisconnected()
+{
+    QLocalSocket *client = qobject_cast<QLocalSocket*>(sender());
+    if (!client)
+        return;
+
+    QMutableMapIterator<UBCFFConversionJob*, JobInfo> nextJob(mJobs);
+    while (nextJob.hasNext()) {
+        nextJob.next();
+        if (nextJob.value().client == client) {
+            nextJob.key()->cancel();
+            nextJob.value().client = NULL;
+        }
+    }
+
+    client->deleteLater();
+}
+
+void UBCFFDaemon::onPagesProgress(int pagesDone, int pageCount)
+{
+    UBCFFConversionJob *job = qobject_cast<UBCFFConversionJob*>(sender());
+    if (!job || !mJobs.contains(job))
+        return;
+
+    JobInfo &info = mJobs[job];
+    info.pages = pagesDone;
+    reply(info.client, QStringList() << "progress" << "id=" + info.id << QString("pages=%1/%2").arg(pagesDone).arg(pageCount));
+}
+
+void UBCFFDaemon::onBytesProgress(qint64 bytesPacked)
+{
+    UBCFFConversionJob *job = qobject_cast<UBCFFConversionJob*>(sender());
+    if (job && mJobs.contains(job))
+        mJobs[job].bytes = bytesPacked;
+}
+
+void UBCFFDaemon::onJobFinished(bool result)
+{
+    UBCFFConversionJob *job = qobject_cast<UBCFFConversionJob*>(sender());
+    if (!job || !mJobs.contains(job))
+        return;
+
+    JobInfo info = mJobs.take(job);
+    if (result)
+        mDoneCount++;
+    else
+        mFailedCount++;
+
+    QString resultStr = result ? "ok" : (job->isCanceled() ? "canceled" : "failed");
+    reply(info.client, QStringList() << "done"
+                                     << "id=" + info.id
+                                     << "result=" + resultStr
+                                     << QString("msecs=%1").arg(info.timer.elapsed())
+                                     << QString("pages=%1").arg(info.pages)
+                                     << QString("bytes=%1").arg(info.bytes));
+
+    // the job waits for its run() to return before it is deleted
+    job->deleteLater();
+}
+
+void UBCFFDaemon::processRequest(QLocalSocket *client, const QString &request)
+{
+    QStringList parts = request.split('\t', QString::SkipEmptyParts);
+    QString command = parts.takeFirst();
+
+    QMap<QString, QString> fields;
+    foreach (QString part, parts) {
+        int delimiter = part.indexOf('=');
+        if (delimiter > 0)
+            fields.insert(part.left(delimiter), part.mid(delimiter + 1));
+    }
+
+    if ("convert" == command) {
+        startJob(client, fields);
+    } else if ("cancel" == command) {
+        cancelJob(client, fields.value("id"));
+    } else if ("status" == command) {
+        reply(client, QStringList() << "status"
+                                    << QString("running=%1").arg(mJobs.count())
+                                    << QString("done=%1").arg(mDoneCount)
+                                    << QString("failed=%1").arg(mFailedCount)
+                                    << QString("workers=%1").arg(mWorkers.maxThreadCount()));
+    } else {
+        reply(client, QStringList() << "error" << "unknown command " + command);
+    }
+}
+
+void UBCFFDaemon::startJob(QLocalSocket *client, const QMap<QString, QString> &fields)
+{
+    QString id = fields.value("id");
+    QString from = fields.value("from");
+    QString to = fields.value("to");
+    if (id.isEmpty() || from.isEmpty() || to.isEmpty()) {
+        reply(client, QStringList() << "error" << "convert needs id, from and to");
+        return;
+    }
+
+    UBCFFConversionJob *job = new UBCFFConversionJob(from, to);
+    job->adaptor()->setCompactOutput(fields.value("compact") == "1");
+    job->adaptor()->setIncremental(fields.value("incremental") == "1");
+    if (!mDocumentCacheDir.isEmpty())
+        job->adaptor()->setDocumentCache(mDocumentCacheDir);
+    if (!mTmpRoot.isEmpty())
+        job->adaptor()->setTmpRoot(mTmpRoot);
+
+    connect(job, SIGNAL(pagesProgress(int, int)), this, SLOT(onPagesProgress(int, int)));
+    connect(job, SIGNAL(bytesProgress(qint64)), this, SLOT(onBytesProgress(qint64)));
+    connect(job, SIGNAL(finished(bool)), this, SLOT(onJobFinished(bool)));
+
+    JobInfo info;
+    info.client = client;
+    info.id = id;
+    info.timer.start();
+    info.pages = 0;
+    info.bytes = 0;
+    mJobs.insert(job, info);
+
+    reply(client, QStringList() << "accepted" << "id=" + id);
+    job->start(&mWorkers);
+}
+
+void UBCFFDaemon::cancelJob(QLocalSocket *client, const QString &id)
+{
+    QMapIterator<UBCFFConversionJob*, JobInfo> nextJob(mJobs);
+    while (nextJob.hasNext()) {
+        nextJob.next();
+        if (nextJob.value().client == client && nextJob.value().id == id) {
+            nextJob.key()->cancel();
+            return;
+        }
+    }
+
+    reply(client, QStringList() << "error" << "no job " + id);
+}
+
+void UBCFFDaemon::reply(QLocalSocket *client, const QStringList &fields)
+{
+    if (!client)
+        return;
+
+    client->write(fields.join("\t").toUtf8() + "\n");
+    client->flush();
+}
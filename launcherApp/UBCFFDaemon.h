@@ -0,0 +1,64 @@
+#ifndef UBCFFDAEMON_H
+#define UBCFFDAEMON_H
+
+#include <QtCore>
+#include <QtNetwork>
+
+class UBCFFConversionJob;
+
+// Conversion server listening on a local socket. Keeps one process (Qt, its image and
+// svg plugins, the document cache) alive for many conversions, runs them on a bounded pool.
+//
+// One request or reply per line, fields are separated by tabs, request fields are key=value:
+//   convert  id=<id>  from=<ubz>  to=<iwb>  [compact=1]  [incremental=1]
+//   cancel   id=<id>
+//   status
+// Replies:
+//   accepted id=<id>
+//   progress id=<id>  pages=<done>/<count>
+//   done     id=<id>  result=ok|failed|canceled  msecs=<n>  pages=<n>  bytes=<n>
+//   status   running=<n>  done=<n>  failed=<n>  workers=<n>
+//   error    <message>
+class UBCFFDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    UBCFFDaemon(int workers, const QString &documentCacheDir, const QString &tmpRoot, QObject *parent = 0);
+    ~UBCFFDaemon();
+
+    bool listen(const QString &socketName);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onPagesProgress(int pagesDone, int pageCount);
+    void onBytesProgress(qint64 bytesPacked);
+    void onJobFinished(bool result);
+
+private:
+    struct JobInfo
+    {
+        QLocalSocket *client;
+        QString id;
+        QTime timer;
+        int pages;
+        qint64 bytes;
+    };
+
+    void processRequest(QLocalSocket *client, const QString &request);
+    void startJob(QLocalSocket *client, const QMap<QString, QString> &fields);
+    void cancelJob(QLocalSocket *client, const QString &id);
+    void reply(QLocalSocket *client, const QStringList &fields);
+
+    QLocalServer mServer;
+    QThreadPool mWorkers;
+    QString mDocumentCacheDir;
+    QString mTmpRoot;
+    QMap<UBCFFConversionJob*, JobInfo> mJobs;
+    int mDoneCount;
+    int mFailedCount;
+};
+
+#endif // UBCFFDAEMON_H
@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core
+QT       += core network
 QT       -= gui
 
 TARGET = launcherApp
@@ -22,4 +22,7 @@ linux-g++-64: LIBS += "-L../UBCFFAdaptor/lib/linux" "-lCFF_Adaptor"
 linux-g++:    LIBS += "-L../UBCFFAdaptor/lib/linux" "-lCFF_Adaptor"
 macx:         LIBS += "-L../UBCFFAdaptor/lib/mac"   "-lCFF_Adaptor"
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    UBCFFDaemon.cpp
+
+HEADERS += UBCFFDaemon.h
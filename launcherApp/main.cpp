@@ -1,6 +1,7 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore>
 #include "UBCFFAdaptor.h"
+#include "UBCFFDaemon.h"
 
 
 int main(int argc, char *argv[])
@@ -9,6 +10,54 @@ int main(int argc, char *argv[])
     Q_UNUSED(argv)
     QCoreApplication a(argc, argv);
 
+    // launcherApp --daemon <socket name> [--workers <count>] [--cache <document cache dir>] [--tmp <temp root dir>]
+    QStringList args = a.arguments();
+    int daemonArg = args.indexOf("--daemon");
+    if (daemonArg != -1) {
+        QString socketName = args.value(daemonArg + 1);
+        int workersArg = args.indexOf("--workers");
+        int workers = workersArg != -1 ? args.value(workersArg + 1).toInt() : 0;
+        int cacheArg = args.indexOf("--cache");
+        QString cacheDir = cacheArg != -1 ? args.value(cacheArg + 1) : QString();
+        int tmpArg = args.indexOf("--tmp");
+        QString tmpRoot = tmpArg != -1 ? args.value(tmpArg + 1) : QString();
+
+        if (socketName.isEmpty()) {
+            qDebug() << "usage: launcherApp --daemon <socket name> [--workers <count>] [--cache <dir>] [--tmp <dir>]";
+            return 1;
+        }
+
+        UBCFFDaemon daemon(workers, cacheDir, tmpRoot);
+        if (!daemon.listen(socketName))
+            return 1;
+
+        return a.exec();
+    }
+
+    // launcherApp --convert <from.ubz> <to.iwb | ->, "-" streams the iwb to stdout
+    int convertArg = args.indexOf("--convert");
+    if (convertArg != -1) {
+        QString from = args.value(convertArg + 1);
+        QString to = args.value(convertArg + 2);
+        if (from.isEmpty() || to.isEmpty()) {
+            qDebug() << "usage: launcherApp --convert <from.ubz> <to.iwb | ->";
+            return 1;
+        }
+
+        UBCFFAdaptor adaptor;
+        bool converted;
+        if (to == "-") {
+            QFile out;
+            if (!out.open(stdout, QIODevice::WriteOnly))
+                return 1;
+            converted = adaptor.convertUBZToIWB(from, &out);
+        } else {
+            converted = adaptor.convertUBZToIWB(from, to);
+        }
+
+        return converted ? 0 : 1;
+    }
+
     UBCFFAdaptor testAdaptor;
     testAdaptor.convertUBZToIWB("../resources/suse.ubz", "../resources/newDir/destiantion.iwb");
 
@@ -6,6 +6,10 @@
    Copyright (C) 1998-2005 Gilles Vollant
 */
 
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +33,18 @@
 #define SEEK_SET    0
 #endif
 
+/* 64-bit stdio positioning */
+#if defined(_MSC_VER)
+#define FTELLO_FUNC(stream) _ftelli64(stream)
+#define FSEEKO_FUNC(stream, offset, origin) _fseeki64(stream, offset, origin)
+#elif defined(__MINGW32__)
+#define FTELLO_FUNC(stream) ftello64(stream)
+#define FSEEKO_FUNC(stream, offset, origin) fseeko64(stream, offset, origin)
+#else
+#define FTELLO_FUNC(stream) ftello(stream)
+#define FSEEKO_FUNC(stream, offset, origin) fseeko(stream, offset, origin)
+#endif
+
 voidpf ZCALLBACK fopen_file_func OF((
    voidpf opaque,
    const char* filename,
@@ -46,14 +62,14 @@ uLong ZCALLBACK fwrite_file_func OF((
    const void* buf,
    uLong size));
 
-long ZCALLBACK ftell_file_func OF((
+ZPOS64_T ZCALLBACK ftell_file_func OF((
    voidpf opaque,
    voidpf stream));
 
 long ZCALLBACK fseek_file_func OF((
    voidpf opaque,
    voidpf stream,
-   uLong offset,
+   ZPOS64_T offset,
    int origin));
 
 int ZCALLBACK fclose_file_func OF((
@@ -110,19 +126,19 @@ uLong ZCALLBACK fwrite_file_func (opaque, stream, buf, size)
     return ret;
 }
 
-long ZCALLBACK ftell_file_func (opaque, stream)
+ZPOS64_T ZCALLBACK ftell_file_func (opaque, stream)
    voidpf opaque;
    voidpf stream;
 {
-    long ret;
-    ret = ftell((FILE *)stream);
+    ZPOS64_T ret;
+    ret = (ZPOS64_T)FTELLO_FUNC((FILE *)stream);
     return ret;
 }
 
 long ZCALLBACK fseek_file_func (opaque, stream, offset, origin)
    voidpf opaque;
    voidpf stream;
-   uLong offset;
+   ZPOS64_T offset;
    int origin;
 {
     int fseek_origin=0;
@@ -141,7 +157,9 @@ long ZCALLBACK fseek_file_func (opaque, stream, offset, origin)
     default: return -1;
     }
     ret = 0;
-    fseek((FILE *)stream, offset, fseek_origin);
+    /* the offset is unsigned, a negative relative seek wraps back to it here */
+    if (FSEEKO_FUNC((FILE *)stream, (long long)offset, fseek_origin) != 0)
+        ret = -1;
     return ret;
 }
 
@@ -0,0 +1,148 @@
+/* -- A kind of "standard" GPL license statement --
+QuaZIP - a Qt/C++ wrapper for the ZIP/UNZIP package
+Copyright (C) 2005-2007 Sergey A. Tachenov
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+-- A kind of "standard" GPL license statement ends here --
+
+See COPYING file for GPL.
+
+You are also permitted to use QuaZIP under the terms of LGPL (see
+COPYING.LGPL). You are free to choose either license, but please note
+that QuaZIP makes use of Qt, which is not licensed under LGPL. So if
+you are using Open Source edition of Qt, you therefore MUST use GPL for
+your code based on QuaZIP, since it would be also based on Qt in this
+case. If you are Qt commercial license owner, then you are free to use
+QuaZIP as long as you respect either GPL or LGPL for QuaZIP code.
+*/
+
+#include "qioapi.h"
+
+static voidpf ZCALLBACK qiodevice_open_file_func(voidpf opaque, const char* filename, int mode)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)opaque;
+  Q_UNUSED(filename);
+  QIODevice::OpenMode desiredMode;
+  if((mode&ZLIB_FILEFUNC_MODE_READWRITEFILTER)==ZLIB_FILEFUNC_MODE_READ)
+    desiredMode=QIODevice::ReadOnly;
+  else if(mode&ZLIB_FILEFUNC_MODE_EXISTING)
+    desiredMode=QIODevice::ReadWrite;
+  else
+    desiredMode=QIODevice::WriteOnly;
+  state->pos=0;
+  state->opened=false;
+  if(state->device->isOpen()) {
+    if((state->device->openMode()&desiredMode)!=desiredMode) {
+      qWarning("qiodevice_open_file_func(): device is open in an incompatible mode");
+      return NULL;
+    }
+  } else {
+    if(!state->device->open(desiredMode))
+      return NULL;
+    state->opened=true;
+  }
+  if(!state->device->isSequential())
+    state->pos=state->device->pos();
+  return state;
+}
+
+static uLong ZCALLBACK qiodevice_read_file_func(voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)stream;
+  Q_UNUSED(opaque);
+  qint64 bytesRead=state->device->read((char*)buf, (qint64)size);
+  if(bytesRead<0)
+    return 0;
+  state->pos+=bytesRead;
+  return (uLong)bytesRead;
+}
+
+static uLong ZCALLBACK qiodevice_write_file_func(voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)stream;
+  Q_UNUSED(opaque);
+  qint64 written=state->device->write((const char*)buf, (qint64)size);
+  if(written<0)
+    return 0;
+  state->pos+=written;
+  return (uLong)written;
+}
+
+static ZPOS64_T ZCALLBACK qiodevice_tell_file_func(voidpf opaque, voidpf stream)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)stream;
+  Q_UNUSED(opaque);
+  if(state->device->isSequential())
+    return (ZPOS64_T)state->pos;
+  return (ZPOS64_T)state->device->pos();
+}
+
+static long ZCALLBACK qiodevice_seek_file_func(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)stream;
+  Q_UNUSED(opaque);
+  qint64 current=state->device->isSequential()?state->pos:state->device->pos();
+  qint64 target;
+  switch(origin) {
+    case ZLIB_FILEFUNC_SEEK_SET:
+      target=(qint64)offset;
+      break;
+    case ZLIB_FILEFUNC_SEEK_CUR:
+      target=current+(qint64)offset;
+      break;
+    case ZLIB_FILEFUNC_SEEK_END:
+      if(state->device->isSequential())
+        return -1;
+      target=state->device->size()+(qint64)offset;
+      break;
+    default:
+      return -1;
+  }
+  if(state->device->isSequential())
+    return target==current?0:-1;
+  return state->device->seek(target)?0:-1;
+}
+
+static int ZCALLBACK qiodevice_close_file_func(voidpf opaque, voidpf stream)
+{
+  QuaZipIODeviceState *state=(QuaZipIODeviceState*)stream;
+  Q_UNUSED(opaque);
+  if(state->opened) {
+    state->device->close();
+    state->opened=false;
+  }
+  return 0;
+}
+
+static int ZCALLBACK qiodevice_error_file_func(voidpf opaque, voidpf stream)
+{
+  // QIODevice has no error state, failed reads and writes are reported by their return values
+  Q_UNUSED(opaque);
+  Q_UNUSED(stream);
+  return 0;
+}
+
+void fill_qiodevice_filefunc(zlib_filefunc_def* pzlib_filefunc_def, QuaZipIODeviceState* state)
+{
+  pzlib_filefunc_def->zopen_file=qiodevice_open_file_func;
+  pzlib_filefunc_def->zread_file=qiodevice_read_file_func;
+  pzlib_filefunc_def->zwrite_file=qiodevice_write_file_func;
+  pzlib_filefunc_def->ztell_file=qiodevice_tell_file_func;
+  pzlib_filefunc_def->zseek_file=qiodevice_seek_file_func;
+  pzlib_filefunc_def->zclose_file=qiodevice_close_file_func;
+  pzlib_filefunc_def->zerror_file=qiodevice_error_file_func;
+  pzlib_filefunc_def->opaque=state;
+}
@@ -0,0 +1,63 @@
+#ifndef QUA_QIOAPI_H
+#define QUA_QIOAPI_H
+
+/*
+-- A kind of "standard" GPL license statement --
+QuaZIP - a Qt/C++ wrapper for the ZIP/UNZIP package
+Copyright (C) 2005-2007 Sergey A. Tachenov
+
+This program is free software; you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation; either version 2 of the License, or (at your
+option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+-- A kind of "standard" GPL license statement ends here --
+
+See COPYING file for GPL.
+
+You are also permitted to use QuaZIP under the terms of LGPL (see
+COPYING.LGPL). You are free to choose either license, but please note
+that QuaZIP makes use of Qt, which is not licensed under LGPL. So if
+you are using Open Source edition of Qt, you therefore MUST use GPL for
+your code based on QuaZIP, since it would be also based on Qt in this
+case. If you are Qt commercial license owner, then you are free to use
+QuaZIP as long as you respect either GPL or LGPL for QuaZIP code.
+ **/
+
+#include <QIODevice>
+
+#include "zlib.h"
+#include "ioapi.h"
+
+/// State of the ZIP/UNZIP I/O API working on a QIODevice.
+/** Sequential devices like pipes, sockets or stdout are unable to
+ * tell their position, so the I/O API counts the bytes read and
+ * written itself. Seeking works on random access devices only, so a
+ * sequential device can only be written with data descriptors, see
+ * zipOpen3().
+ **/
+struct QuaZipIODeviceState {
+  /// The device. It is opened by the I/O API if it is not open yet.
+  QIODevice *device;
+  /// Number of bytes read or written since the device was opened.
+  qint64 pos;
+  /// \c true if the I/O API opened the device and has to close it.
+  bool opened;
+};
+
+/// Fills \a pzlib_filefunc_def with the functions working on \a state.
+/** \a state must be valid until the ZIP/UNZIP file is closed. Its
+ * device must be set, the other fields are initialized on open.
+ **/
+void fill_qiodevice_filefunc(zlib_filefunc_def* pzlib_filefunc_def, QuaZipIODeviceState* state);
+
+#endif
@@ -37,15 +37,27 @@ QuaZIP as long as you respect either GPL or LGPL for QuaZIP code.
 QuaZip::QuaZip():
   fileNameCodec(QTextCodec::codecForLocale()),
   commentCodec(QTextCodec::codecForLocale()),
-  mode(mdNotOpen), hasCurrentFile_f(false), zipError(UNZ_OK)
+  ioDevice(NULL),
+  mode(mdNotOpen), hasCurrentFile_f(false), zipError(UNZ_OK),
+  hasDirectory_f(false)
 {
 }
 
 QuaZip::QuaZip(const QString& zipName):
   fileNameCodec(QTextCodec::codecForLocale()),
   commentCodec(QTextCodec::codecForLocale()),
-  zipName(zipName),
-  mode(mdNotOpen), hasCurrentFile_f(false), zipError(UNZ_OK)
+  zipName(zipName), ioDevice(NULL),
+  mode(mdNotOpen), hasCurrentFile_f(false), zipError(UNZ_OK),
+  hasDirectory_f(false)
+{
+}
+
+QuaZip::QuaZip(QIODevice *ioDevice):
+  fileNameCodec(QTextCodec::codecForLocale()),
+  commentCodec(QTextCodec::codecForLocale()),
+  ioDevice(ioDevice),
+  mode(mdNotOpen), hasCurrentFile_f(false), zipError(UNZ_OK),
+  hasDirectory_f(false)
 {
 }
 
@@ -61,6 +73,19 @@ bool QuaZip::open(Mode mode, zlib_filefunc_def* ioApi)
     qWarning("QuaZip::open(): ZIP already opened");
     return false;
   }
+  unsigned flags=0;
+  if(ioDevice!=NULL&&ioApi==NULL) {
+    if(ioDevice->isSequential()) {
+      if(mode!=mdCreate) {
+        qWarning("QuaZip::open(): a sequential device can only be open in mdCreate mode");
+        return false;
+      }
+      flags|=ZIP_WRITE_DATA_DESCRIPTOR;
+    }
+    ioDeviceState.device=ioDevice;
+    fill_qiodevice_filefunc(&ioDeviceApi, &ioDeviceState);
+    ioApi=&ioDeviceApi;
+  }
   switch(mode) {
     case mdUnzip:
       unzFile_f=unzOpen2(QFile::encodeName(zipName).constData(), ioApi);
@@ -74,12 +99,13 @@ bool QuaZip::open(Mode mode, zlib_filefunc_def* ioApi)
     case mdCreate:
     case mdAppend:
     case mdAdd:
-      zipFile_f=zipOpen2(QFile::encodeName(zipName).constData(),
+      zipFile_f=zipOpen3(QFile::encodeName(zipName).constData(),
           mode==mdCreate?APPEND_STATUS_CREATE:
           mode==mdAppend?APPEND_STATUS_CREATEAFTER:
           APPEND_STATUS_ADDINZIP,
           NULL,
-          ioApi);
+          ioApi,
+          flags);
       if(zipFile_f!=NULL) {
         this->mode=mode;
         return true;
@@ -114,6 +140,9 @@ void QuaZip::close()
       return;
   }
   if(zipError==UNZ_OK) mode=mdNotOpen;
+  hasDirectory_f=false;
+  directory.clear();
+  directoryIndex.clear();
 }
 
 void QuaZip::setZipName(const QString& zipName)
@@ -125,6 +154,15 @@ void QuaZip::setZipName(const QString& zipName)
   this->zipName=zipName;
 }
 
+void QuaZip::setIoDevice(QIODevice *ioDevice)
+{
+  if(isOpen()) {
+    qWarning("QuaZip::setIoDevice(): ZIP is already open!");
+    return;
+  }
+  this->ioDevice=ioDevice;
+}
+
 int QuaZip::getEntriesCount()const
 {
   QuaZip *fakeThis=(QuaZip*)this; // non-const
@@ -177,14 +215,13 @@ bool QuaZip::setCurrentFile(const QString& fileName, CaseSensitivity cs)
     zipError=UNZ_PARAMERROR;
     return false;
   }
-  bool sens;
-  if(cs==csDefault) {
-#ifdef Q_WS_WIN
-    sens=false;
-#else
-    sens=true;
-#endif
-  } else sens=cs==csSensitive;
+  if(hasDirectory_f) {
+    hasCurrentFile_f=false;
+    int index=findEntry(fileName, cs);
+    if(index==-1) return false;
+    return goToEntry(directory.at(index));
+  }
+  bool sens=isCaseSensitive(cs);
   QString lower, current;
   if(!sens) lower=fileName.toLower();
   hasCurrentFile_f=false;
@@ -277,9 +314,105 @@ QString QuaZip::getCurrentFileName()const
     return QString();
   }
   if(!isOpen()||!hasCurrentFile()) return QString();
+  if(hasDirectory_f) {
+    unz_file_pos pos;
+    if((fakeThis->zipError=unzGetFilePos(unzFile_f, &pos))!=UNZ_OK)
+      return QString();
+    if(pos.num_of_file<(uLong)directory.size())
+      return directory.at((int)pos.num_of_file).name;
+  }
   QByteArray fileName(MAX_FILE_NAME_LENGTH, 0);
   if((fakeThis->zipError=unzGetCurrentFileInfo(unzFile_f, NULL, fileName.data(), fileName.size(),
       NULL, 0, NULL, 0))!=UNZ_OK)
     return QString();
   return fileNameCodec->toUnicode(fileName.constData());
 }
+
+bool QuaZip::isCaseSensitive(CaseSensitivity cs)
+{
+  if(cs==csDefault) {
+#ifdef Q_WS_WIN
+    return false;
+#else
+    return true;
+#endif
+  }
+  return cs==csSensitive;
+}
+
+bool QuaZip::loadDirectory()
+{
+  zipError=UNZ_OK;
+  if(mode!=mdUnzip) {
+    qWarning("QuaZip::loadDirectory(): ZIP is not open in mdUnzip mode");
+    return false;
+  }
+  hasDirectory_f=false;
+  directory.clear();
+  directoryIndex.clear();
+  unz_global_info globalInfo;
+  if((zipError=unzGetGlobalInfo(unzFile_f, &globalInfo))!=UNZ_OK)
+    return false;
+  directory.reserve((int)globalInfo.number_entry);
+  // name length is a 16-bit field, so one buffer fits every name
+  QByteArray fileName(0xffff+1, 0);
+  unz_file_info info_z;
+  QuaZipDirEntry entry;
+  for(zipError=unzGoToFirstFile(unzFile_f); zipError==UNZ_OK;
+      zipError=unzGoToNextFile(unzFile_f)) {
+    if((zipError=unzGetCurrentFileInfo(unzFile_f, &info_z, fileName.data(), fileName.size(),
+        NULL, 0, NULL, 0))!=UNZ_OK)
+      break;
+    if((zipError=unzGetFilePos(unzFile_f, &entry.pos))!=UNZ_OK)
+      break;
+    entry.name=fileNameCodec->toUnicode(fileName.constData(), (int)info_z.size_filename);
+    entry.flags=info_z.flag;
+    entry.method=info_z.compression_method;
+    entry.dosDate=info_z.dosDate;
+    entry.crc=info_z.crc;
+    entry.compressedSize=info_z.compressed_size;
+    entry.uncompressedSize=info_z.uncompressed_size;
+    // the first of duplicated names wins, as with the directory walk
+    if(!directoryIndex.contains(entry.name))
+      directoryIndex.insert(entry.name, directory.size());
+    directory.append(entry);
+  }
+  hasCurrentFile_f=false;
+  if(zipError!=UNZ_END_OF_LIST_OF_FILE) {
+    directory.clear();
+    directoryIndex.clear();
+    return false;
+  }
+  zipError=UNZ_OK;
+  hasDirectory_f=true;
+  return true;
+}
+
+int QuaZip::findEntry(const QString& fileName, CaseSensitivity cs)const
+{
+  if(!hasDirectory_f) {
+    qWarning("QuaZip::findEntry(): the directory is not loaded");
+    return -1;
+  }
+  if(isCaseSensitive(cs))
+    return directoryIndex.value(fileName, -1);
+  QString lower=fileName.toLower();
+  for(int i=0; i<directory.size(); ++i) {
+    if(directory.at(i).name.toLower()==lower)
+      return i;
+  }
+  return -1;
+}
+
+bool QuaZip::goToEntry(const QuaZipDirEntry& entry)
+{
+  zipError=UNZ_OK;
+  if(mode!=mdUnzip) {
+    qWarning("QuaZip::goToEntry(): ZIP is not open in mdUnzip mode");
+    return false;
+  }
+  unz_file_pos pos=entry.pos;
+  zipError=unzGoToFilePos(unzFile_f, &pos);
+  hasCurrentFile_f=zipError==UNZ_OK;
+  return hasCurrentFile_f;
+}
@@ -33,12 +33,16 @@ case. If you are Qt commercial license owner, then you are free to use
 QuaZIP as long as you respect either GPL or LGPL for QuaZIP code.
  **/
 
+#include <QHash>
 #include <QString>
 #include <QTextCodec>
+#include <QVector>
 
 #include "zip.h"
 #include "unzip.h"
 
+#include "qioapi.h"
+#include "quazipdirentry.h"
 #include "quazipfileinfo.h"
 
 // just in case it will be defined in the later versions of the ZIP/UNZIP
@@ -122,6 +126,9 @@ class QuaZip {
   private:
     QTextCodec *fileNameCodec, *commentCodec;
     QString zipName;
+    QIODevice *ioDevice;
+    QuaZipIODeviceState ioDeviceState;
+    zlib_filefunc_def ioDeviceApi;
     QString comment;
     Mode mode;
     union {
@@ -130,6 +137,10 @@ class QuaZip {
     };
     bool hasCurrentFile_f;
     int zipError;
+    bool hasDirectory_f;
+    QVector<QuaZipDirEntry> directory;
+    QHash<QString, int> directoryIndex;
+    static bool isCaseSensitive(CaseSensitivity cs);
     // not (and will not be) implemented
     QuaZip(const QuaZip& that);
     // not (and will not be) implemented
@@ -140,6 +151,9 @@ class QuaZip {
     QuaZip();
     /// Constructs QuaZip object associated with ZIP file \a zipName.
     QuaZip(const QString& zipName);
+    /// Constructs QuaZip object working on \a ioDevice.
+    /** See setIoDevice(). */
+    QuaZip(QIODevice *ioDevice);
     /// Destroys QuaZip object.
     /** Calls close() if necessary. */
     ~QuaZip();
@@ -203,6 +217,20 @@ class QuaZip {
     {commentCodec=QTextCodec::codecForName(commentCodecName);}
     /// Returns the codec used to encode/decode comments inside archive.
     QTextCodec* getCommentCodec()const {return commentCodec;}
+    /// Sets the device to read or write the ZIP archive.
+    /** The device is used instead of the ZIP file name. open() opens it
+     * if it is not open yet, and close() closes it then. The device is
+     * not owned and must be valid until the archive is closed.
+     *
+     * A sequential device (a pipe, a socket, stdout) can only be opened
+     * in the mdCreate mode. The archive is then written strictly
+     * sequentially: the CRC and the sizes of each file follow its data
+     * in a data descriptor instead of being written back into the local
+     * header. Pass \c NULL to use the ZIP file name again.
+     **/
+    void setIoDevice(QIODevice *ioDevice);
+    /// Returns the device set by setIoDevice(), or \c NULL.
+    QIODevice* getIoDevice()const {return ioDevice;}
     /// Returns the name of the ZIP file.
     /** Returns null string if no ZIP file name has been set.
      * \sa setZipName()
@@ -318,6 +346,41 @@ class QuaZip {
      * Should be used only in QuaZip::mdUnzip mode.
      **/
     QString getCurrentFileName()const;
+    /// Loads the whole central directory into memory in a single pass.
+    /** Every entry is read once and its name is decoded with the
+     * current file name codec, so set the codec before calling this.
+     * Returns \c true on success, \c false otherwise. Call
+     * getZipError() to get the error code.
+     *
+     * Once the directory is loaded setCurrentFile() and
+     * getCurrentFileName() use it instead of reading the archive. It
+     * is dropped by close().
+     *
+     * The current file is unset after this call.
+     *
+     * Should be used only in QuaZip::mdUnzip mode.
+     **/
+    bool loadDirectory();
+    /// Returns \c true if the central directory has been loaded.
+    bool hasDirectory()const {return hasDirectory_f;}
+    /// Returns the central directory snapshot made by loadDirectory().
+    /** Entries are in the central directory order. The vector is
+     * implicitly shared, so copies may be handed to other threads.
+     **/
+    const QVector<QuaZipDirEntry>& getDirectory()const {return directory;}
+    /// Returns the index of \a fileName in getDirectory(), or -1.
+    /** Does not access the archive, the directory has to be loaded.
+     * \sa loadDirectory(), CaseSensitivity
+     **/
+    int findEntry(const QString& fileName, CaseSensitivity cs =csDefault)const;
+    /// Sets the current file to \a entry of the directory snapshot.
+    /** Jumps straight to the entry instead of walking the directory.
+     * Returns \c true on success, \c false otherwise. Call
+     * getZipError() to get the error code.
+     *
+     * Should be used only in QuaZip::mdUnzip mode.
+     **/
+    bool goToEntry(const QuaZipDirEntry& entry);
     /// Returns \c unzFile handle.
     /** You can use this handle to directly call UNZIP part of the
      * ZIP/UNZIP package functions (see unzip.h).
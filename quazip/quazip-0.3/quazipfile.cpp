@@ -229,14 +229,14 @@ bool QuaZipFile::open(OpenMode mode, const QuaZipNewInfo& info,
     info_z.dosDate = 0;
     info_z.internal_fa=(uLong)info.internalAttr;
     info_z.external_fa=(uLong)info.externalAttr;
-    setZipError(zipOpenNewFileInZip3(zip->getZipFile(),
+    setZipError(zipOpenNewFileInZip3_64(zip->getZipFile(),
           zip->getFileNameCodec()->fromUnicode(info.name).constData(), &info_z,
           info.extraLocal.constData(), info.extraLocal.length(),
           info.extraGlobal.constData(), info.extraGlobal.length(),
           zip->getCommentCodec()->fromUnicode(info.comment).constData(),
           method, level, (int)raw,
           windowBits, memLevel, strategy,
-          password, (uLong)crc));
+          password, (uLong)crc, info.uncompressedSize>=0xffffffffu ? 1 : 0));
     if(zipError==UNZ_OK) {
       writePos=0;
       setOpenMode(mode);
@@ -269,7 +269,7 @@ qint64 QuaZipFile::pos()const
     return -1;
   }
   if(openMode()&ReadOnly)
-    return unztell(zip->getUnzFile());
+    return (qint64)unztell64(zip->getUnzFile());
   else
     return writePos;
 }
@@ -343,7 +343,7 @@ void QuaZipFile::close()
   if(openMode()&ReadOnly)
     setZipError(unzCloseCurrentFile(zip->getUnzFile()));
   else if(openMode()&WriteOnly)
-    if(isRaw()) setZipError(zipCloseFileInZipRaw(zip->getZipFile(), uncompressedSize, crc));
+    if(isRaw()) setZipError(zipCloseFileInZipRaw64(zip->getZipFile(), uncompressedSize, crc));
     else setZipError(zipCloseFileInZip(zip->getZipFile()));
   else {
     qWarning("Wrong open mode: %d", (int)openMode());
@@ -357,9 +357,13 @@ void QuaZipFile::close()
   }
 }
 
+// ZIP/UNZIP API reads and writes at most an unsigned int at a time
+static const qint64 MAX_CHUNK=0x40000000;
+
 qint64 QuaZipFile::readData(char *data, qint64 maxSize)
 {
   setZipError(UNZ_OK);
+  if(maxSize>MAX_CHUNK) maxSize=MAX_CHUNK;
   qint64 bytesRead=unzReadCurrentFile(zip->getUnzFile(), data, (unsigned)maxSize);
   if(bytesRead<0) setZipError((int)bytesRead);
   return bytesRead;
@@ -368,10 +372,13 @@ qint64 QuaZipFile::readData(char *data, qint64 maxSize)
 qint64 QuaZipFile::writeData(const char* data, qint64 maxSize)
 {
   setZipError(ZIP_OK);
-  setZipError(zipWriteInFileInZip(zip->getZipFile(), data, (uint)maxSize));
-  if(zipError!=ZIP_OK) return -1;
-  else {
-    writePos+=maxSize;
-    return maxSize;
+  qint64 written=0;
+  while(written<maxSize) {
+    qint64 chunk=qMin(maxSize-written, MAX_CHUNK);
+    setZipError(zipWriteInFileInZip(zip->getZipFile(), data+written, (uint)chunk));
+    if(zipError!=ZIP_OK) return -1;
+    written+=chunk;
   }
+  writePos+=written;
+  return written;
 }
@@ -77,7 +77,7 @@ class QuaZipFile: public QIODevice {
     bool raw;
     qint64 writePos;
     // these two are for writing raw files
-    ulong uncompressedSize;
+    quint64 uncompressedSize;
     quint32 crc;
     bool internal;
     int zipError;
@@ -266,6 +266,14 @@ class QuaZipFile: public QIODevice {
      * \sa open(OpenMode,int*,int*,bool,const char*)
      **/
     bool isRaw()const {return raw;}
+    /// Sets the CRC and the uncompressed size of a file opened for raw writing.
+    /** These values are normally passed to open() and written to the
+     * archive by close(). Use this function when the raw
+     * data is produced while it is being written, so that the CRC is only
+     * known after the last write. Must be called before close().
+     **/
+    void setRawFileInfo(quint32 crc, quint64 uncompressedSize)
+    {this->crc=crc; this->uncompressedSize=uncompressedSize;}
     /// Binds to the existing QuaZip instance.
     /** This function destroys internal QuaZip object, if any, and makes
      * this QuaZipFile to use current file in the \a zip object for any
@@ -336,6 +344,10 @@ class QuaZipFile: public QIODevice {
      * If \a raw is \c true, no compression is performed. In this case,
      * \a crc and uncompressedSize field of the \a info are required.
      *
+     * The file is written in the ZIP64 format if the uncompressedSize
+     * field of the \a info is 4 GB or more, so set it when adding large
+     * files.
+     *
      * Arguments \a windowBits, \a memLevel, \a strategy provide zlib
      * algorithms tuning. See deflateInit2() in zlib.
      **/
@@ -347,7 +359,7 @@ class QuaZipFile: public QIODevice {
     virtual bool isSequential()const;
     /// Returns current position in the file.
     /** Implementation of the QIODevice::pos(). When reading, this
-     * function is a wrapper to the ZIP/UNZIP unztell(), therefore it is
+     * function is a wrapper to the ZIP/UNZIP unztell64(), therefore it is
      * unable to keep track of the ungetChar() calls (which is
      * non-virtual and therefore is dangerous to reimplement). So if you
      * are using ungetChar() feature of the QIODevice, this function
@@ -55,9 +55,9 @@ struct QuaZipFileInfo {
   /// CRC.
   quint32 crc;
   /// Compressed file size.
-  quint32 compressedSize;
+  quint64 compressedSize;
   /// Uncompressed file size.
-  quint32 uncompressedSize;
+  quint64 uncompressedSize;
   /// Disk number start.
   quint16 diskNumberStart;
   /// Internal file attributes.
@@ -68,22 +68,26 @@ struct QuaZipNewInfo {
   /// File global extra field.
   QByteArray extraGlobal;
   /// Uncompressed file size.
-  /** This is only needed if you are using raw file zipping mode, i. e.
-   * adding precompressed file in the zip archive.
+  /** This is needed if you are using raw file zipping mode, i. e.
+   * adding precompressed file in the zip archive. Otherwise it is a
+   * size hint: files of 4 GB and more need the ZIP64 format, which is
+   * only used for the local header when the size is known in advance.
+   * Zero by default.
    **/
-  ulong uncompressedSize;
+  quint64 uncompressedSize;
   /// Constructs QuaZipNewInfo instance.
   /** Initializes name with \a name, dateTime with current date and
-   * time. Attributes are initialized with zeros, comment and extra
-   * field with null values.
+   * time. Attributes and uncompressed size are initialized with zeros,
+   * comment and extra field with null values.
    **/
   QuaZipNewInfo(const QString& name);
   /// Constructs QuaZipNewInfo instance.
   /** Initializes name with \a name and dateTime with timestamp of the
    * file named \a file. If the \a file does not exists or its timestamp
    * is inaccessible (e. g. you do not have read permission for the
-   * directory file in), uses current date and time. Attributes are
-   * initialized with zeros, comment and extra field with null values.
+   * directory file in), uses current date and time. Attributes and
+   * uncompressed size are initialized with zeros, comment and extra
+   * field with null values.
    * 
    * \sa setFileDateTime()
    **/
@@ -83,6 +83,13 @@ woven in by Terry Thorsen 1/2003.
 
 #define SIZECENTRALDIRITEM (0x2e)
 #define SIZEZIPLOCALHEADER (0x1e)
+#define SIZECENTRALDIRRECORD (0x16)
+#define SIZEZIP64CENTRALDIRLOCATOR (0x14)
+#define SIZEZIP64CENTRALDIRRECORD (0x38)
+
+#define ZIP64CENTRALDIRLOCATORMAGIC (0x07064b50)
+#define ZIP64CENTRALDIRRECORDMAGIC (0x06064b50)
+#define ZIP64EXTRAFIELDID (0x0001)
 
 
 
@@ -93,7 +100,8 @@ const char unz_copyright[] =
 /* unz_file_info_interntal contain internal info about a file in zipfile*/
 typedef struct unz_file_info_internal_s
 {
-    uLong offset_curfile;/* relative offset of local header 4 bytes */
+    ZPOS64_T offset_curfile;/* relative offset of local header 4 bytes,
+                               8 bytes in the ZIP64 extra field */
 } unz_file_info_internal;
 
 
@@ -104,21 +112,22 @@ typedef struct
     char  *read_buffer;         /* internal buffer for compressed data */
     z_stream stream;            /* zLib stream structure for inflate */
 
-    uLong pos_in_zipfile;       /* position in byte on the zipfile, for fseek*/
+    ZPOS64_T pos_in_zipfile;    /* position in byte on the zipfile, for fseek*/
     uLong stream_initialised;   /* flag set if stream structure is initialised*/
 
-    uLong offset_local_extrafield;/* offset of the local extra field */
+    ZPOS64_T offset_local_extrafield;/* offset of the local extra field */
     uInt  size_local_extrafield;/* size of the local extra field */
     uLong pos_local_extrafield;   /* position in the local extra field in read*/
 
     uLong crc32;                /* crc32 of all data uncompressed */
     uLong crc32_wait;           /* crc32 we must obtain after decompress all */
-    uLong rest_read_compressed; /* number of byte to be decompressed */
-    uLong rest_read_uncompressed;/*number of byte to be obtained after decomp*/
+    ZPOS64_T rest_read_compressed; /* number of byte to be decompressed */
+    ZPOS64_T rest_read_uncompressed;/*number of byte to be obtained after decomp*/
+    ZPOS64_T total_out_64;      /* stream.total_out is only a uLong */
     zlib_filefunc_def z_filefunc;
     voidpf filestream;        /* io structore of the zipfile */
     uLong compression_method;   /* compression method (0==store) */
-    uLong byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
+    ZPOS64_T byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
     int   raw;
 } file_in_zip_read_info_s;
 
@@ -130,14 +139,14 @@ typedef struct
     zlib_filefunc_def z_filefunc;
     voidpf filestream;        /* io structore of the zipfile */
     unz_global_info gi;       /* public global information */
-    uLong byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
+    ZPOS64_T byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
     uLong num_file;             /* number of the current file in the zipfile*/
-    uLong pos_in_central_dir;   /* pos of the current file in the central dir*/
+    ZPOS64_T pos_in_central_dir;/* pos of the current file in the central dir*/
     uLong current_file_ok;      /* flag about the usability of the current file*/
-    uLong central_pos;          /* position of the beginning of the central dir*/
+    ZPOS64_T central_pos;       /* position of the end of central dir record*/
 
-    uLong size_central_dir;     /* size of the central directory  */
-    uLong offset_central_dir;   /* offset of start of central directory with
+    ZPOS64_T size_central_dir;  /* size of the central directory  */
+    ZPOS64_T offset_central_dir;/* offset of start of central directory with
                                    respect to the starting disk number */
 
     unz_file_info cur_file_info; /* public info about the current file in zip*/
@@ -157,104 +166,61 @@ typedef struct
 #endif
 
 /* ===========================================================================
-     Read a byte from a gz_stream; update next_in and avail_in. Return EOF
-   for end of file.
+     Read a whole fixed-size header record with a single ZREAD, the fields are
+   then decoded in place with unzlocal_getShortFromBuffer/unzlocal_getLongFromBuffer.
    IN assertion: the stream s has been sucessfully opened for reading.
 */
 
 
-local int unzlocal_getByte OF((
+local int unzlocal_readRecord OF((
     const zlib_filefunc_def* pzlib_filefunc_def,
     voidpf filestream,
-    int *pi));
+    unsigned char *buf,
+    uLong size));
 
-local int unzlocal_getByte(pzlib_filefunc_def,filestream,pi)
+local int unzlocal_readRecord(pzlib_filefunc_def,filestream,buf,size)
     const zlib_filefunc_def* pzlib_filefunc_def;
     voidpf filestream;
-    int *pi;
+    unsigned char *buf;
+    uLong size;
 {
-    unsigned char c;
-    int err = (int)ZREAD(*pzlib_filefunc_def,filestream,&c,1);
-    if (err==1)
-    {
-        *pi = (int)c;
+    if (ZREAD(*pzlib_filefunc_def,filestream,buf,size)==size)
         return UNZ_OK;
-    }
+
+    if (ZERROR(*pzlib_filefunc_def,filestream))
+        return UNZ_ERRNO;
     else
-    {
-        if (ZERROR(*pzlib_filefunc_def,filestream))
-            return UNZ_ERRNO;
-        else
-            return UNZ_EOF;
-    }
+        return UNZ_EOF;
 }
 
 
 /* ===========================================================================
-   Reads a long in LSB order from the given gz_stream. Sets
+   Decodes a short/long stored in LSB order at buf.
 */
-local int unzlocal_getShort OF((
-    const zlib_filefunc_def* pzlib_filefunc_def,
-    voidpf filestream,
-    uLong *pX));
+local uLong unzlocal_getShortFromBuffer OF((const unsigned char *buf));
 
-local int unzlocal_getShort (pzlib_filefunc_def,filestream,pX)
-    const zlib_filefunc_def* pzlib_filefunc_def;
-    voidpf filestream;
-    uLong *pX;
+local uLong unzlocal_getShortFromBuffer (buf)
+    const unsigned char *buf;
 {
-    uLong x ;
-    int i;
-    int err;
-
-    err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==UNZ_OK)
-        err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<8;
-
-    if (err==UNZ_OK)
-        *pX = x;
-    else
-        *pX = 0;
-    return err;
+    return (uLong)buf[0] | ((uLong)buf[1]<<8);
 }
 
-local int unzlocal_getLong OF((
-    const zlib_filefunc_def* pzlib_filefunc_def,
-    voidpf filestream,
-    uLong *pX));
+local uLong unzlocal_getLongFromBuffer OF((const unsigned char *buf));
 
-local int unzlocal_getLong (pzlib_filefunc_def,filestream,pX)
-    const zlib_filefunc_def* pzlib_filefunc_def;
-    voidpf filestream;
-    uLong *pX;
+local uLong unzlocal_getLongFromBuffer (buf)
+    const unsigned char *buf;
 {
-    uLong x ;
-    int i;
-    int err;
-
-    err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==UNZ_OK)
-        err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<8;
+    return (uLong)buf[0] | ((uLong)buf[1]<<8) |
+           ((uLong)buf[2]<<16) | ((uLong)buf[3]<<24);
+}
 
-    if (err==UNZ_OK)
-        err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<16;
+local ZPOS64_T unzlocal_getLong64FromBuffer OF((const unsigned char *buf));
 
-    if (err==UNZ_OK)
-        err = unzlocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<24;
-
-    if (err==UNZ_OK)
-        *pX = x;
-    else
-        *pX = 0;
-    return err;
+local ZPOS64_T unzlocal_getLong64FromBuffer (buf)
+    const unsigned char *buf;
+{
+    return (ZPOS64_T)unzlocal_getLongFromBuffer(buf) |
+           ((ZPOS64_T)unzlocal_getLongFromBuffer(buf+4)<<32);
 }
 
 
@@ -324,19 +290,19 @@ extern int ZEXPORT unzStringFileNameCompare (fileName1,fileName2,iCaseSensitivit
   Locate the Central directory of a zipfile (at the end, just before
     the global comment)
 */
-local uLong unzlocal_SearchCentralDir OF((
+local ZPOS64_T unzlocal_SearchCentralDir OF((
     const zlib_filefunc_def* pzlib_filefunc_def,
     voidpf filestream));
 
-local uLong unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
+local ZPOS64_T unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     const zlib_filefunc_def* pzlib_filefunc_def;
     voidpf filestream;
 {
     unsigned char* buf;
-    uLong uSizeFile;
+    ZPOS64_T uSizeFile;
     uLong uBackRead;
     uLong uMaxBack=0xffff; /* maximum size of global comment */
-    uLong uPosFound=0;
+    ZPOS64_T uPosFound=0;
 
     if (ZSEEK(*pzlib_filefunc_def,filestream,0,ZLIB_FILEFUNC_SEEK_END) != 0)
         return 0;
@@ -345,7 +311,7 @@ local uLong unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     uSizeFile = ZTELL(*pzlib_filefunc_def,filestream);
 
     if (uMaxBack>uSizeFile)
-        uMaxBack = uSizeFile;
+        uMaxBack = (uLong)uSizeFile;
 
     buf = (unsigned char*)ALLOC(BUFREADCOMMENT+4);
     if (buf==NULL)
@@ -354,7 +320,8 @@ local uLong unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     uBackRead = 4;
     while (uBackRead<uMaxBack)
     {
-        uLong uReadSize,uReadPos ;
+        uLong uReadSize;
+        ZPOS64_T uReadPos;
         int i;
         if (uBackRead+BUFREADCOMMENT>uMaxBack)
             uBackRead = uMaxBack;
@@ -363,7 +330,7 @@ local uLong unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
         uReadPos = uSizeFile-uBackRead ;
 
         uReadSize = ((BUFREADCOMMENT+4) < (uSizeFile-uReadPos)) ?
-                     (BUFREADCOMMENT+4) : (uSizeFile-uReadPos);
+                     (BUFREADCOMMENT+4) : (uLong)(uSizeFile-uReadPos);
         if (ZSEEK(*pzlib_filefunc_def,filestream,uReadPos,ZLIB_FILEFUNC_SEEK_SET)!=0)
             break;
 
@@ -385,6 +352,78 @@ local uLong unzlocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     return uPosFound;
 }
 
+/*
+  Read the ZIP64 end of central directory record of a zipfile whose end of
+    central directory record is at central_pos, if the zipfile has one.
+  Returns UNZ_OK and fills the 64-bit values if it has been found,
+    UNZ_END_OF_LIST_OF_FILE if the zipfile is not a ZIP64 one.
+*/
+local int unzlocal_ReadZip64CentralDir OF((
+    const zlib_filefunc_def* pzlib_filefunc_def,
+    voidpf filestream,
+    ZPOS64_T central_pos,
+    ZPOS64_T* pzip64_pos,
+    ZPOS64_T* pnumber_entry,
+    ZPOS64_T* pnumber_entry_CD,
+    ZPOS64_T* psize_central_dir,
+    ZPOS64_T* poffset_central_dir));
+
+local int unzlocal_ReadZip64CentralDir(pzlib_filefunc_def,filestream,central_pos,
+                                       pzip64_pos,pnumber_entry,pnumber_entry_CD,
+                                       psize_central_dir,poffset_central_dir)
+    const zlib_filefunc_def* pzlib_filefunc_def;
+    voidpf filestream;
+    ZPOS64_T central_pos;
+    ZPOS64_T* pzip64_pos;
+    ZPOS64_T* pnumber_entry;
+    ZPOS64_T* pnumber_entry_CD;
+    ZPOS64_T* psize_central_dir;
+    ZPOS64_T* poffset_central_dir;
+{
+    unsigned char locator[SIZEZIP64CENTRALDIRLOCATOR];
+    unsigned char record[SIZEZIP64CENTRALDIRRECORD];
+    ZPOS64_T zip64_pos;
+
+    if (central_pos<SIZEZIP64CENTRALDIRLOCATOR)
+        return UNZ_END_OF_LIST_OF_FILE;
+
+    /* the locator immediately precedes the end of central directory record */
+    if (ZSEEK(*pzlib_filefunc_def,filestream,
+              central_pos-SIZEZIP64CENTRALDIRLOCATOR,ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return UNZ_ERRNO;
+    if (unzlocal_readRecord(pzlib_filefunc_def,filestream,
+                            locator,SIZEZIP64CENTRALDIRLOCATOR)!=UNZ_OK)
+        return UNZ_ERRNO;
+    if (unzlocal_getLongFromBuffer(locator)!=ZIP64CENTRALDIRLOCATORMAGIC)
+        return UNZ_END_OF_LIST_OF_FILE;
+
+    /* spanned archives are not supported */
+    if ((unzlocal_getLongFromBuffer(locator+4)!=0) ||
+        (unzlocal_getLongFromBuffer(locator+16)>1))
+        return UNZ_BADZIPFILE;
+
+    zip64_pos = unzlocal_getLong64FromBuffer(locator+8);
+    if (ZSEEK(*pzlib_filefunc_def,filestream,zip64_pos,ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return UNZ_ERRNO;
+    if (unzlocal_readRecord(pzlib_filefunc_def,filestream,
+                            record,SIZEZIP64CENTRALDIRRECORD)!=UNZ_OK)
+        return UNZ_ERRNO;
+    if (unzlocal_getLongFromBuffer(record)!=ZIP64CENTRALDIRRECORDMAGIC)
+        return UNZ_BADZIPFILE;
+
+    /* number of this disk and of the disk with the start of the central directory */
+    if ((unzlocal_getLongFromBuffer(record+16)!=0) ||
+        (unzlocal_getLongFromBuffer(record+20)!=0))
+        return UNZ_BADZIPFILE;
+
+    *pzip64_pos = zip64_pos;
+    *pnumber_entry = unzlocal_getLong64FromBuffer(record+24);
+    *pnumber_entry_CD = unzlocal_getLong64FromBuffer(record+32);
+    *psize_central_dir = unzlocal_getLong64FromBuffer(record+40);
+    *poffset_central_dir = unzlocal_getLong64FromBuffer(record+48);
+    return UNZ_OK;
+}
+
 /*
   Open a Zip file. path contain the full pathname (by example,
      on a Windows NT computer "c:\\test\\zlib114.zip" or on an Unix computer
@@ -400,7 +439,8 @@ extern unzFile ZEXPORT unzOpen2 (path, pzlib_filefunc_def)
 {
     unz_s us;
     unz_s *s;
-    uLong central_pos,uL;
+    ZPOS64_T central_pos;
+    ZPOS64_T central_end;       /* where the central directory has to end */
 
     uLong number_disk;          /* number of the current dist, used for
                                    spaning ZIP, unsupported, always 0*/
@@ -435,45 +475,65 @@ extern unzFile ZEXPORT unzOpen2 (path, pzlib_filefunc_def)
                                       central_pos,ZLIB_FILEFUNC_SEEK_SET)!=0)
         err=UNZ_ERRNO;
 
-    /* the signature, already checked */
-    if (unzlocal_getLong(&us.z_filefunc, us.filestream,&uL)!=UNZ_OK)
-        err=UNZ_ERRNO;
+    if (err==UNZ_OK)
+    {
+        unsigned char record[SIZECENTRALDIRRECORD];
+        if (unzlocal_readRecord(&us.z_filefunc, us.filestream,
+                                record,SIZECENTRALDIRRECORD)!=UNZ_OK)
+            err=UNZ_ERRNO;
+        else
+        {
+            /* the signature, already checked */
 
-    /* number of this disk */
-    if (unzlocal_getShort(&us.z_filefunc, us.filestream,&number_disk)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* number of this disk */
+            number_disk = unzlocal_getShortFromBuffer(record+4);
 
-    /* number of the disk with the start of the central directory */
-    if (unzlocal_getShort(&us.z_filefunc, us.filestream,&number_disk_with_CD)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* number of the disk with the start of the central directory */
+            number_disk_with_CD = unzlocal_getShortFromBuffer(record+6);
 
-    /* total number of entries in the central dir on this disk */
-    if (unzlocal_getShort(&us.z_filefunc, us.filestream,&us.gi.number_entry)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* total number of entries in the central dir on this disk */
+            us.gi.number_entry = unzlocal_getShortFromBuffer(record+8);
 
-    /* total number of entries in the central dir */
-    if (unzlocal_getShort(&us.z_filefunc, us.filestream,&number_entry_CD)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* total number of entries in the central dir */
+            number_entry_CD = unzlocal_getShortFromBuffer(record+10);
 
-    if ((number_entry_CD!=us.gi.number_entry) ||
-        (number_disk_with_CD!=0) ||
-        (number_disk!=0))
-        err=UNZ_BADZIPFILE;
+            /* size of the central directory */
+            us.size_central_dir = unzlocal_getLongFromBuffer(record+12);
 
-    /* size of the central directory */
-    if (unzlocal_getLong(&us.z_filefunc, us.filestream,&us.size_central_dir)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* offset of start of central directory with respect to the
+                  starting disk number */
+            us.offset_central_dir = unzlocal_getLongFromBuffer(record+16);
 
-    /* offset of start of central directory with respect to the
-          starting disk number */
-    if (unzlocal_getLong(&us.z_filefunc, us.filestream,&us.offset_central_dir)!=UNZ_OK)
-        err=UNZ_ERRNO;
+            /* zipfile comment length */
+            us.gi.size_comment = unzlocal_getShortFromBuffer(record+20);
+        }
+    }
 
-    /* zipfile comment length */
-    if (unzlocal_getShort(&us.z_filefunc, us.filestream,&us.gi.size_comment)!=UNZ_OK)
-        err=UNZ_ERRNO;
+    /* a ZIP64 end of central directory record overrides the values above */
+    central_end = central_pos;
+    if (err==UNZ_OK)
+    {
+        ZPOS64_T zip64_pos,number_entry64,number_entry_CD64;
+        int err64 = unzlocal_ReadZip64CentralDir(&us.z_filefunc,us.filestream,central_pos,
+                                                 &zip64_pos,&number_entry64,&number_entry_CD64,
+                                                 &us.size_central_dir,&us.offset_central_dir);
+        if (err64==UNZ_OK)
+        {
+            us.gi.number_entry = (uLong)number_entry64;
+            if ((number_entry_CD64!=number_entry64) ||
+                ((ZPOS64_T)us.gi.number_entry!=number_entry64))
+                err=UNZ_BADZIPFILE;
+            central_end = zip64_pos;
+        }
+        else if (err64!=UNZ_END_OF_LIST_OF_FILE)
+            err=err64;
+        else if ((number_entry_CD!=us.gi.number_entry) ||
+                 (number_disk_with_CD!=0) ||
+                 (number_disk!=0))
+            err=UNZ_BADZIPFILE;
+    }
 
-    if ((central_pos<us.offset_central_dir+us.size_central_dir) &&
+    if ((central_end<us.offset_central_dir+us.size_central_dir) &&
         (err==UNZ_OK))
         err=UNZ_BADZIPFILE;
 
@@ -483,7 +543,7 @@ extern unzFile ZEXPORT unzOpen2 (path, pzlib_filefunc_def)
         return NULL;
     }
 
-    us.byte_before_the_zipfile = central_pos -
+    us.byte_before_the_zipfile = central_end -
                             (us.offset_central_dir+us.size_central_dir);
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
@@ -560,6 +620,80 @@ local void unzlocal_DosDateToTmuDate (ulDosDate, ptm)
     ptm->tm_sec =  (uInt) (2*(ulDosDate&0x1f)) ;
 }
 
+/*
+  Read the ZIP64 extended information extra field of the current central
+    directory entry. Only the values saturated to 0xFFFFFFFF in the fixed
+    part of the header are stored there, in this order.
+*/
+local int unzlocal_ReadZip64ExtraField OF((unz_s* s,
+                                           ZPOS64_T extra_pos,
+                                           uLong size_extra,
+                                           unz_file_info *pfile_info,
+                                           unz_file_info_internal *pfile_info_internal));
+
+local int unzlocal_ReadZip64ExtraField (s, extra_pos, size_extra, pfile_info, pfile_info_internal)
+    unz_s* s;
+    ZPOS64_T extra_pos;
+    uLong size_extra;
+    unz_file_info *pfile_info;
+    unz_file_info_internal *pfile_info_internal;
+{
+    unsigned char* extra;
+    uLong pos = 0;
+    int err = UNZ_OK;
+
+    if (size_extra==0)
+        return UNZ_BADZIPFILE;
+
+    extra = (unsigned char*)ALLOC(size_extra);
+    if (extra==NULL)
+        return UNZ_INTERNALERROR;
+
+    if (ZSEEK(s->z_filefunc, s->filestream, extra_pos, ZLIB_FILEFUNC_SEEK_SET)!=0)
+        err=UNZ_ERRNO;
+    else if (unzlocal_readRecord(&s->z_filefunc, s->filestream, extra, size_extra)!=UNZ_OK)
+        err=UNZ_ERRNO;
+
+    while ((err==UNZ_OK) && (pos+4<=size_extra))
+    {
+        uLong header_id = unzlocal_getShortFromBuffer(extra+pos);
+        uLong data_size = unzlocal_getShortFromBuffer(extra+pos+2);
+        uLong data_pos = pos+4;
+        pos = data_pos+data_size;
+        if (pos>size_extra)
+            break;
+        if (header_id!=ZIP64EXTRAFIELDID)
+            continue;
+
+        if (pfile_info->uncompressed_size==0xFFFFFFFF)
+        {
+            if (data_pos+8>pos)
+                break;
+            pfile_info->uncompressed_size = unzlocal_getLong64FromBuffer(extra+data_pos);
+            data_pos += 8;
+        }
+        if (pfile_info->compressed_size==0xFFFFFFFF)
+        {
+            if (data_pos+8>pos)
+                break;
+            pfile_info->compressed_size = unzlocal_getLong64FromBuffer(extra+data_pos);
+            data_pos += 8;
+        }
+        if (pfile_info_internal->offset_curfile==0xFFFFFFFF)
+        {
+            if (data_pos+8>pos)
+                break;
+            pfile_info_internal->offset_curfile = unzlocal_getLong64FromBuffer(extra+data_pos);
+            data_pos += 8;
+        }
+        TRYFREE(extra);
+        return UNZ_OK;
+    }
+
+    TRYFREE(extra);
+    return (err==UNZ_OK) ? UNZ_BADZIPFILE : err;
+}
+
 /*
   Get Info about the current file in the zipfile, with internal only info
 */
@@ -594,7 +728,7 @@ local int unzlocal_GetCurrentFileInfoInternal (file,
     unz_file_info file_info;
     unz_file_info_internal file_info_internal;
     int err=UNZ_OK;
-    uLong uMagic;
+    unsigned char record[SIZECENTRALDIRITEM];
     long lSeek=0;
 
     if (file==NULL)
@@ -606,60 +740,36 @@ local int unzlocal_GetCurrentFileInfoInternal (file,
         err=UNZ_ERRNO;
 
 
-    /* we check the magic */
+    /* the whole fixed part of the header is read at once, then decoded */
     if (err==UNZ_OK) {
-        if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uMagic) != UNZ_OK)
+        if (unzlocal_readRecord(&s->z_filefunc, s->filestream,
+                                record,SIZECENTRALDIRITEM) != UNZ_OK)
             err=UNZ_ERRNO;
-        else if (uMagic!=0x02014b50)
+        else if (unzlocal_getLongFromBuffer(record)!=0x02014b50)
             err=UNZ_BADZIPFILE;
     }
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.version) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.version_needed) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.flag) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.compression_method) != UNZ_OK)
-        err=UNZ_ERRNO;
+    if (err!=UNZ_OK)
+        return err;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.dosDate) != UNZ_OK)
-        err=UNZ_ERRNO;
+    file_info.version = unzlocal_getShortFromBuffer(record+4);
+    file_info.version_needed = unzlocal_getShortFromBuffer(record+6);
+    file_info.flag = unzlocal_getShortFromBuffer(record+8);
+    file_info.compression_method = unzlocal_getShortFromBuffer(record+10);
+    file_info.dosDate = unzlocal_getLongFromBuffer(record+12);
 
     unzlocal_DosDateToTmuDate(file_info.dosDate,&file_info.tmu_date);
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.crc) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.compressed_size) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.uncompressed_size) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_filename) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_file_extra) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.size_file_comment) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.disk_num_start) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&file_info.internal_fa) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info.external_fa) != UNZ_OK)
-        err=UNZ_ERRNO;
-
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&file_info_internal.offset_curfile) != UNZ_OK)
-        err=UNZ_ERRNO;
+    file_info.crc = unzlocal_getLongFromBuffer(record+16);
+    file_info.compressed_size = unzlocal_getLongFromBuffer(record+20);
+    file_info.uncompressed_size = unzlocal_getLongFromBuffer(record+24);
+    file_info.size_filename = unzlocal_getShortFromBuffer(record+28);
+    file_info.size_file_extra = unzlocal_getShortFromBuffer(record+30);
+    file_info.size_file_comment = unzlocal_getShortFromBuffer(record+32);
+    file_info.disk_num_start = unzlocal_getShortFromBuffer(record+34);
+    file_info.internal_fa = unzlocal_getShortFromBuffer(record+36);
+    file_info.external_fa = unzlocal_getLongFromBuffer(record+38);
+    file_info_internal.offset_curfile = unzlocal_getLongFromBuffer(record+42);
 
     lSeek+=file_info.size_filename;
     if ((err==UNZ_OK) && (szFileName!=NULL))
@@ -728,6 +838,15 @@ local int unzlocal_GetCurrentFileInfoInternal (file,
     else
         lSeek+=file_info.size_file_comment;
 
+    if ((err==UNZ_OK) &&
+        ((file_info.uncompressed_size==0xFFFFFFFF) ||
+         (file_info.compressed_size==0xFFFFFFFF) ||
+         (file_info_internal.offset_curfile==0xFFFFFFFF)))
+        err = unzlocal_ReadZip64ExtraField(s,
+                  s->pos_in_central_dir+s->byte_before_the_zipfile+
+                      SIZECENTRALDIRITEM+file_info.size_filename,
+                  file_info.size_file_extra,&file_info,&file_info_internal);
+
     if ((err==UNZ_OK) && (pfile_info!=NULL))
         *pfile_info=file_info;
 
@@ -838,7 +957,7 @@ extern int ZEXPORT unzLocateFile (file, szFileName, iCaseSensitivity)
     unz_file_info cur_file_infoSaved;
     unz_file_info_internal cur_file_info_internalSaved;
     uLong num_fileSaved;
-    uLong pos_in_central_dirSaved;
+    ZPOS64_T pos_in_central_dirSaved;
 
 
     if (file==NULL)
@@ -962,10 +1081,11 @@ local int unzlocal_CheckCurrentFileCoherencyHeader (s,piSizeVar,
                                                     psize_local_extrafield)
     unz_s* s;
     uInt* piSizeVar;
-    uLong *poffset_local_extrafield;
+    ZPOS64_T *poffset_local_extrafield;
     uInt  *psize_local_extrafield;
 {
-    uLong uMagic,uData,uFlags;
+    unsigned char record[SIZEZIPLOCALHEADER];
+    uLong uData,uFlags;
     uLong size_filename;
     uLong size_extra_field;
     int err=UNZ_OK;
@@ -979,62 +1099,55 @@ local int unzlocal_CheckCurrentFileCoherencyHeader (s,piSizeVar,
         return UNZ_ERRNO;
 
 
-    if (err==UNZ_OK) {
-        if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uMagic) != UNZ_OK)
-            err=UNZ_ERRNO;
-        else if (uMagic!=0x04034b50)
-            err=UNZ_BADZIPFILE;
-    }
+    if (unzlocal_readRecord(&s->z_filefunc, s->filestream,
+                            record,SIZEZIPLOCALHEADER) != UNZ_OK)
+        return UNZ_ERRNO;
+
+    if (unzlocal_getLongFromBuffer(record)!=0x04034b50)
+        err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uData) != UNZ_OK)
-        err=UNZ_ERRNO;
 /*
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.wVersion))
+    else if ((err==UNZ_OK) && (unzlocal_getShortFromBuffer(record+4)!=s->cur_file_info.wVersion))
         err=UNZ_BADZIPFILE;
 */
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uFlags) != UNZ_OK)
-        err=UNZ_ERRNO;
+    uFlags = unzlocal_getShortFromBuffer(record+6);
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&uData) != UNZ_OK)
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
+    uData = unzlocal_getShortFromBuffer(record+8);
+    if ((err==UNZ_OK) && (uData!=s->cur_file_info.compression_method))
         err=UNZ_BADZIPFILE;
 
     if ((err==UNZ_OK) && (s->cur_file_info.compression_method!=0) &&
                          (s->cur_file_info.compression_method!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* date/time */
-        err=UNZ_ERRNO;
+    /* date/time at record+10 is not checked */
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* crc */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.crc) &&
-                              ((uFlags & 8)==0))
+    uData = unzlocal_getLongFromBuffer(record+14); /* crc */
+    if ((err==UNZ_OK) && (uData!=s->cur_file_info.crc) &&
+                         ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* size compr */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.compressed_size) &&
-                              ((uFlags & 8)==0))
+    /* 0xFFFFFFFF means the size is in the local ZIP64 extra field,
+       the central directory already gave the actual one */
+    uData = unzlocal_getLongFromBuffer(record+18); /* size compr */
+    if ((err==UNZ_OK) && (uData!=0xFFFFFFFF) &&
+                         (uData!=s->cur_file_info.compressed_size) &&
+                         ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-    if (unzlocal_getLong(&s->z_filefunc, s->filestream,&uData) != UNZ_OK) /* size uncompr */
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (uData!=s->cur_file_info.uncompressed_size) &&
-                              ((uFlags & 8)==0))
+    uData = unzlocal_getLongFromBuffer(record+22); /* size uncompr */
+    if ((err==UNZ_OK) && (uData!=0xFFFFFFFF) &&
+                         (uData!=s->cur_file_info.uncompressed_size) &&
+                         ((uFlags & 8)==0))
         err=UNZ_BADZIPFILE;
 
-
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&size_filename) != UNZ_OK)
-        err=UNZ_ERRNO;
-    else if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
+    size_filename = unzlocal_getShortFromBuffer(record+26);
+    if ((err==UNZ_OK) && (size_filename!=s->cur_file_info.size_filename))
         err=UNZ_BADZIPFILE;
 
     *piSizeVar += (uInt)size_filename;
 
-    if (unzlocal_getShort(&s->z_filefunc, s->filestream,&size_extra_field) != UNZ_OK)
-        err=UNZ_ERRNO;
+    size_extra_field = unzlocal_getShortFromBuffer(record+28);
     *poffset_local_extrafield= s->cur_file_info_internal.offset_curfile +
                                     SIZEZIPLOCALHEADER + size_filename;
     *psize_local_extrafield = (uInt)size_extra_field;
@@ -1059,7 +1172,7 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
     uInt iSizeVar;
     unz_s* s;
     file_in_zip_read_info_s* pfile_in_zip_read_info;
-    uLong offset_local_extrafield;  /* offset of the local extra field */
+    ZPOS64_T offset_local_extrafield;  /* offset of the local extra field */
     uInt  size_local_extrafield;    /* size of the local extra field */
 #    ifndef NOUNCRYPT
     char source[12];
@@ -1127,6 +1240,7 @@ extern int ZEXPORT unzOpenCurrentFile3 (file, method, level, raw, password)
     pfile_in_zip_read_info->byte_before_the_zipfile=s->byte_before_the_zipfile;
 
     pfile_in_zip_read_info->stream.total_out = 0;
+    pfile_in_zip_read_info->total_out_64 = 0;
 
     if ((s->cur_file_info.compression_method==Z_DEFLATED) &&
         (!raw))
@@ -1335,6 +1449,7 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
             pfile_in_zip_read_info->stream.next_out += uDoCopy;
             pfile_in_zip_read_info->stream.next_in += uDoCopy;
             pfile_in_zip_read_info->stream.total_out += uDoCopy;
+            pfile_in_zip_read_info->total_out_64 += uDoCopy;
             iRead += uDoCopy;
         }
         else
@@ -1367,6 +1482,7 @@ extern int ZEXPORT unzReadCurrentFile  (file, buf, len)
 
             pfile_in_zip_read_info->rest_read_uncompressed -=
                 uOutThis;
+            pfile_in_zip_read_info->total_out_64 += uOutThis;
 
             iRead += (uInt)(uTotalOutAfter - uTotalOutBefore);
 
@@ -1402,6 +1518,25 @@ extern z_off_t ZEXPORT unztell (file)
     return (z_off_t)pfile_in_zip_read_info->stream.total_out;
 }
 
+/*
+  Give the current position in uncompressed data, not limited to 4 GB
+*/
+extern ZPOS64_T ZEXPORT unztell64 (file)
+    unzFile file;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+    if (file==NULL)
+        return (ZPOS64_T)-1;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return (ZPOS64_T)-1;
+
+    return pfile_in_zip_read_info->total_out_64;
+}
+
 
 /*
   return 1 if the end of file was reached, 0 elsewhere
@@ -1564,7 +1699,7 @@ extern int ZEXPORT unzGetGlobalComment (file, szComment, uSizeBuf)
 }
 
 /* Additions by RX '2004 */
-extern uLong ZEXPORT unzGetOffset (file)
+extern ZPOS64_T ZEXPORT unzGetOffset (file)
     unzFile file;
 {
     unz_s* s;
@@ -1582,7 +1717,7 @@ extern uLong ZEXPORT unzGetOffset (file)
 
 extern int ZEXPORT unzSetOffset (file, pos)
         unzFile file;
-        uLong pos;
+        ZPOS64_T pos;
 {
     unz_s* s;
     int err;
@@ -88,11 +88,26 @@ const char zip_copyright[] =
 #define LOCALHEADERMAGIC    (0x04034b50)
 #define CENTRALHEADERMAGIC  (0x02014b50)
 #define ENDHEADERMAGIC      (0x06054b50)
+#define DATADESCRIPTORMAGIC (0x08074b50)
 
 #define FLAG_LOCALHEADER_OFFSET (0x06)
 #define CRC_LOCALHEADER_OFFSET  (0x0e)
 
 #define SIZECENTRALHEADER (0x2e) /* 46 */
+#define SIZECENTRALDIRRECORD (0x16) /* 22 */
+
+#define ZIP64ENDHEADERMAGIC      (0x06064b50)
+#define ZIP64ENDLOCHEADERMAGIC   (0x07064b50)
+#define ZIP64EXTRAFIELDID        (0x0001)
+#define VERSIONNEEDEDZIP64       (45)
+
+#define SIZEZIP64CENTRALDIRLOCATOR (0x14) /* 20 */
+#define SIZEZIP64CENTRALDIRRECORD (0x38) /* 56 */
+#define SIZEZIP64LOCALEXTRAFIELD (0x14) /* 20, both sizes */
+#define MAXUINT32                (0xffffffff)
+
+/* ziplocal_ReadZip64CentralDir() result for a zipfile without ZIP64 records */
+#define ZIP64_NOT_FOUND          (-150)
 
 typedef struct linkedlist_datablock_internal_s
 {
@@ -116,7 +131,7 @@ typedef struct
     int  stream_initialised;    /* 1 is stream is initialised */
     uInt pos_in_buffered_data;  /* last written byte in buffered_data */
 
-    uLong pos_local_header;     /* offset of the local header of the file
+    ZPOS64_T pos_local_header;  /* offset of the local header of the file
                                      currenty writing */
     char* central_header;       /* central header data for the current file */
     uLong size_centralheader;   /* size of the central header for cur file */
@@ -128,6 +143,10 @@ typedef struct
     uLong dosDate;
     uLong crc32;
     int  encrypt;
+    int  zip64;                 /* local header has a ZIP64 extra field */
+    ZPOS64_T pos_zip64extrainfo;/* offset of the data of that extra field */
+    ZPOS64_T totalCompressedData;
+    ZPOS64_T totalUncompressedData;
 #ifndef NOCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
     const unsigned long* pcrc_32_tab;
@@ -143,9 +162,10 @@ typedef struct
     int  in_opened_file_inzip;  /* 1 if a file in the zip is currently writ.*/
     curfile_info ci;            /* info on the file curretly writing */
 
-    uLong begin_pos;            /* position of the beginning of the zipfile */
-    uLong add_position_when_writting_offset;
-    uLong number_entry;
+    ZPOS64_T begin_pos;         /* position of the beginning of the zipfile */
+    ZPOS64_T add_position_when_writting_offset;
+    ZPOS64_T number_entry;
+    unsigned flags;             /* ZIP_WRITE_DATA_DESCRIPTOR */
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
 #endif
@@ -259,18 +279,18 @@ local int add_data_in_datablock(ll,buf,len)
 #ifndef NO_ADDFILEINEXISTINGZIP
 /* ===========================================================================
    Inputs a long in LSB order to the given file
-   nbByte == 1, 2 or 4 (byte, short or long)
+   nbByte == 1, 2, 4 or 8 (byte, short, long or ZIP64 value)
 */
 
 local int ziplocal_putValue OF((const zlib_filefunc_def* pzlib_filefunc_def,
-                                voidpf filestream, uLong x, int nbByte));
+                                voidpf filestream, ZPOS64_T x, int nbByte));
 local int ziplocal_putValue (pzlib_filefunc_def, filestream, x, nbByte)
     const zlib_filefunc_def* pzlib_filefunc_def;
     voidpf filestream;
-    uLong x;
+    ZPOS64_T x;
     int nbByte;
 {
-    unsigned char buf[4];
+    unsigned char buf[8];
     int n;
     for (n = 0; n < nbByte; n++)
     {
@@ -291,10 +311,10 @@ local int ziplocal_putValue (pzlib_filefunc_def, filestream, x, nbByte)
         return ZIP_OK;
 }
 
-local void ziplocal_putValue_inmemory OF((void* dest, uLong x, int nbByte));
+local void ziplocal_putValue_inmemory OF((void* dest, ZPOS64_T x, int nbByte));
 local void ziplocal_putValue_inmemory (dest, x, nbByte)
     void* dest;
-    uLong x;
+    ZPOS64_T x;
     int nbByte;
 {
     unsigned char* buf=(unsigned char*)dest;
@@ -333,98 +353,59 @@ local uLong ziplocal_TmzDateToDosDate(ptm,dosDate)
 
 /****************************************************************************/
 
-local int ziplocal_getByte OF((
+/* ===========================================================================
+   Reads a whole fixed-size header record with a single ZREAD, the fields are
+   then decoded in place with ziplocal_getShortFromBuffer/ziplocal_getLongFromBuffer.
+*/
+local int ziplocal_readRecord OF((
     const zlib_filefunc_def* pzlib_filefunc_def,
     voidpf filestream,
-    int *pi));
+    unsigned char *buf,
+    uLong size));
 
-local int ziplocal_getByte(pzlib_filefunc_def,filestream,pi)
+local int ziplocal_readRecord(pzlib_filefunc_def,filestream,buf,size)
     const zlib_filefunc_def* pzlib_filefunc_def;
     voidpf filestream;
-    int *pi;
+    unsigned char *buf;
+    uLong size;
 {
-    unsigned char c;
-    int err = (int)ZREAD(*pzlib_filefunc_def,filestream,&c,1);
-    if (err==1)
-    {
-        *pi = (int)c;
+    if (ZREAD(*pzlib_filefunc_def,filestream,buf,size)==size)
         return ZIP_OK;
-    }
+
+    if (ZERROR(*pzlib_filefunc_def,filestream))
+        return ZIP_ERRNO;
     else
-    {
-        if (ZERROR(*pzlib_filefunc_def,filestream))
-            return ZIP_ERRNO;
-        else
-            return ZIP_EOF;
-    }
+        return ZIP_BADZIPFILE;
 }
 
 
 /* ===========================================================================
-   Reads a long in LSB order from the given gz_stream. Sets
+   Decodes a short/long stored in LSB order at buf.
 */
-local int ziplocal_getShort OF((
-    const zlib_filefunc_def* pzlib_filefunc_def,
-    voidpf filestream,
-    uLong *pX));
+local uLong ziplocal_getShortFromBuffer OF((const unsigned char *buf));
 
-local int ziplocal_getShort (pzlib_filefunc_def,filestream,pX)
-    const zlib_filefunc_def* pzlib_filefunc_def;
-    voidpf filestream;
-    uLong *pX;
+local uLong ziplocal_getShortFromBuffer (buf)
+    const unsigned char *buf;
 {
-    uLong x ;
-    int i;
-    int err;
-
-    err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==ZIP_OK)
-        err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<8;
-
-    if (err==ZIP_OK)
-        *pX = x;
-    else
-        *pX = 0;
-    return err;
+    return (uLong)buf[0] | ((uLong)buf[1]<<8);
 }
 
-local int ziplocal_getLong OF((
-    const zlib_filefunc_def* pzlib_filefunc_def,
-    voidpf filestream,
-    uLong *pX));
+local uLong ziplocal_getLongFromBuffer OF((const unsigned char *buf));
 
-local int ziplocal_getLong (pzlib_filefunc_def,filestream,pX)
-    const zlib_filefunc_def* pzlib_filefunc_def;
-    voidpf filestream;
-    uLong *pX;
+local uLong ziplocal_getLongFromBuffer (buf)
+    const unsigned char *buf;
 {
-    uLong x ;
-    int i;
-    int err;
-
-    err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x = (uLong)i;
-
-    if (err==ZIP_OK)
-        err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<8;
-
-    if (err==ZIP_OK)
-        err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<16;
+    return (uLong)buf[0] | ((uLong)buf[1]<<8) |
+           ((uLong)buf[2]<<16) | ((uLong)buf[3]<<24);
+}
 
-    if (err==ZIP_OK)
-        err = ziplocal_getByte(pzlib_filefunc_def,filestream,&i);
-    x += ((uLong)i)<<24;
+local ZPOS64_T ziplocal_getLong64FromBuffer OF((const unsigned char *buf));
 
-    if (err==ZIP_OK)
-        *pX = x;
-    else
-        *pX = 0;
-    return err;
+local ZPOS64_T ziplocal_getLong64FromBuffer (buf)
+    const unsigned char *buf;
+{
+    return (ZPOS64_T)ziplocal_getLongFromBuffer(buf) |
+           ((ZPOS64_T)ziplocal_getLongFromBuffer(buf+4)<<32);
 }
 
 #ifndef BUFREADCOMMENT
@@ -434,19 +415,19 @@ local int ziplocal_getLong (pzlib_filefunc_def,filestream,pX)
   Locate the Central directory of a zipfile (at the end, just before
     the global comment)
 */
-local uLong ziplocal_SearchCentralDir OF((
+local ZPOS64_T ziplocal_SearchCentralDir OF((
     const zlib_filefunc_def* pzlib_filefunc_def,
     voidpf filestream));
 
-local uLong ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
+local ZPOS64_T ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     const zlib_filefunc_def* pzlib_filefunc_def;
     voidpf filestream;
 {
     unsigned char* buf;
-    uLong uSizeFile;
+    ZPOS64_T uSizeFile;
     uLong uBackRead;
     uLong uMaxBack=0xffff; /* maximum size of global comment */
-    uLong uPosFound=0;
+    ZPOS64_T uPosFound=0;
 
     if (ZSEEK(*pzlib_filefunc_def,filestream,0,ZLIB_FILEFUNC_SEEK_END) != 0)
         return 0;
@@ -455,7 +436,7 @@ local uLong ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     uSizeFile = ZTELL(*pzlib_filefunc_def,filestream);
 
     if (uMaxBack>uSizeFile)
-        uMaxBack = uSizeFile;
+        uMaxBack = (uLong)uSizeFile;
 
     buf = (unsigned char*)ALLOC(BUFREADCOMMENT+4);
     if (buf==NULL)
@@ -464,7 +445,8 @@ local uLong ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     uBackRead = 4;
     while (uBackRead<uMaxBack)
     {
-        uLong uReadSize,uReadPos ;
+        uLong uReadSize;
+        ZPOS64_T uReadPos;
         int i;
         if (uBackRead+BUFREADCOMMENT>uMaxBack)
             uBackRead = uMaxBack;
@@ -473,7 +455,7 @@ local uLong ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
         uReadPos = uSizeFile-uBackRead ;
 
         uReadSize = ((BUFREADCOMMENT+4) < (uSizeFile-uReadPos)) ?
-                     (BUFREADCOMMENT+4) : (uSizeFile-uReadPos);
+                     (BUFREADCOMMENT+4) : (uLong)(uSizeFile-uReadPos);
         if (ZSEEK(*pzlib_filefunc_def,filestream,uReadPos,ZLIB_FILEFUNC_SEEK_SET)!=0)
             break;
 
@@ -494,14 +476,87 @@ local uLong ziplocal_SearchCentralDir(pzlib_filefunc_def,filestream)
     TRYFREE(buf);
     return uPosFound;
 }
+
+/*
+  Read the ZIP64 end of central directory record of a zipfile whose end of
+    central directory record is at central_pos, if the zipfile has one.
+  Returns ZIP_OK and fills the 64-bit values if it has been found,
+    ZIP64_NOT_FOUND if the zipfile is not a ZIP64 one (ZIP_EOF is the same as ZIP_OK).
+*/
+local int ziplocal_ReadZip64CentralDir OF((
+    const zlib_filefunc_def* pzlib_filefunc_def,
+    voidpf filestream,
+    ZPOS64_T central_pos,
+    ZPOS64_T* pzip64_pos,
+    ZPOS64_T* pnumber_entry,
+    ZPOS64_T* pnumber_entry_CD,
+    ZPOS64_T* psize_central_dir,
+    ZPOS64_T* poffset_central_dir));
+
+local int ziplocal_ReadZip64CentralDir(pzlib_filefunc_def,filestream,central_pos,
+                                       pzip64_pos,pnumber_entry,pnumber_entry_CD,
+                                       psize_central_dir,poffset_central_dir)
+    const zlib_filefunc_def* pzlib_filefunc_def;
+    voidpf filestream;
+    ZPOS64_T central_pos;
+    ZPOS64_T* pzip64_pos;
+    ZPOS64_T* pnumber_entry;
+    ZPOS64_T* pnumber_entry_CD;
+    ZPOS64_T* psize_central_dir;
+    ZPOS64_T* poffset_central_dir;
+{
+    unsigned char locator[SIZEZIP64CENTRALDIRLOCATOR];
+    unsigned char record[SIZEZIP64CENTRALDIRRECORD];
+    ZPOS64_T zip64_pos;
+
+    if (central_pos<SIZEZIP64CENTRALDIRLOCATOR)
+        return ZIP64_NOT_FOUND;
+
+    /* the locator immediately precedes the end of central directory record */
+    if (ZSEEK(*pzlib_filefunc_def,filestream,
+              central_pos-SIZEZIP64CENTRALDIRLOCATOR,ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return ZIP_ERRNO;
+    if (ziplocal_readRecord(pzlib_filefunc_def,filestream,
+                            locator,SIZEZIP64CENTRALDIRLOCATOR)!=ZIP_OK)
+        return ZIP_ERRNO;
+    if (ziplocal_getLongFromBuffer(locator)!=ZIP64ENDLOCHEADERMAGIC)
+        return ZIP64_NOT_FOUND;
+
+    /* spanned archives are not supported */
+    if ((ziplocal_getLongFromBuffer(locator+4)!=0) ||
+        (ziplocal_getLongFromBuffer(locator+16)>1))
+        return ZIP_BADZIPFILE;
+
+    zip64_pos = ziplocal_getLong64FromBuffer(locator+8);
+    if (ZSEEK(*pzlib_filefunc_def,filestream,zip64_pos,ZLIB_FILEFUNC_SEEK_SET)!=0)
+        return ZIP_ERRNO;
+    if (ziplocal_readRecord(pzlib_filefunc_def,filestream,
+                            record,SIZEZIP64CENTRALDIRRECORD)!=ZIP_OK)
+        return ZIP_ERRNO;
+    if (ziplocal_getLongFromBuffer(record)!=ZIP64ENDHEADERMAGIC)
+        return ZIP_BADZIPFILE;
+
+    /* number of this disk and of the disk with the start of the central directory */
+    if ((ziplocal_getLongFromBuffer(record+16)!=0) ||
+        (ziplocal_getLongFromBuffer(record+20)!=0))
+        return ZIP_BADZIPFILE;
+
+    *pzip64_pos = zip64_pos;
+    *pnumber_entry = ziplocal_getLong64FromBuffer(record+24);
+    *pnumber_entry_CD = ziplocal_getLong64FromBuffer(record+32);
+    *psize_central_dir = ziplocal_getLong64FromBuffer(record+40);
+    *poffset_central_dir = ziplocal_getLong64FromBuffer(record+48);
+    return ZIP_OK;
+}
 #endif /* !NO_ADDFILEINEXISTINGZIP*/
 
 /************************************************************/
-extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc_def)
+extern zipFile ZEXPORT zipOpen3 (pathname, append, globalcomment, pzlib_filefunc_def, flags)
     const char *pathname;
     int append;
     zipcharpc* globalcomment;
     zlib_filefunc_def* pzlib_filefunc_def;
+    unsigned flags;
 {
     zip_internal ziinit;
     zip_internal* zi;
@@ -527,6 +582,7 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
     ziinit.ci.stream_initialised = 0;
     ziinit.number_entry = 0;
     ziinit.add_position_when_writting_offset = 0;
+    ziinit.flags = flags & ZIP_WRITE_DATA_DESCRIPTOR;
     init_linkedlist(&(ziinit.central_dir));
 
 
@@ -542,18 +598,19 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
     ziinit.globalcomment = NULL;
     if (append == APPEND_STATUS_ADDINZIP)
     {
-        uLong byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
+        ZPOS64_T byte_before_the_zipfile;/* byte before the zipfile, (>0 for sfx)*/
 
-        uLong size_central_dir;     /* size of the central directory  */
-        uLong offset_central_dir;   /* offset of start of central directory */
-        uLong central_pos,uL;
+        ZPOS64_T size_central_dir;  /* size of the central directory  */
+        ZPOS64_T offset_central_dir;/* offset of start of central directory */
+        ZPOS64_T central_pos;
+        ZPOS64_T central_end;       /* where the central directory has to end */
 
         uLong number_disk;          /* number of the current dist, used for
                                     spaning ZIP, unsupported, always 0*/
         uLong number_disk_with_CD;  /* number the the disk with central dir, used
                                     for spaning ZIP, unsupported, always 0*/
-        uLong number_entry;
-        uLong number_entry_CD;      /* total number of entries in
+        ZPOS64_T number_entry;
+        ZPOS64_T number_entry_CD;   /* total number of entries in
                                     the central dir
                                     (same than number_entry on nospan) */
         uLong size_comment;
@@ -566,45 +623,61 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
                                         central_pos,ZLIB_FILEFUNC_SEEK_SET)!=0)
             err=ZIP_ERRNO;
 
-        /* the signature, already checked */
-        if (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&uL)!=ZIP_OK)
-            err=ZIP_ERRNO;
+        if (err==ZIP_OK)
+        {
+            unsigned char record[SIZECENTRALDIRRECORD];
+            if (ziplocal_readRecord(&ziinit.z_filefunc, ziinit.filestream,
+                                    record,SIZECENTRALDIRRECORD)!=ZIP_OK)
+                err=ZIP_ERRNO;
+            else
+            {
+                /* the signature, already checked */
 
-        /* number of this disk */
-        if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&number_disk)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* number of this disk */
+                number_disk = ziplocal_getShortFromBuffer(record+4);
 
-        /* number of the disk with the start of the central directory */
-        if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&number_disk_with_CD)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* number of the disk with the start of the central directory */
+                number_disk_with_CD = ziplocal_getShortFromBuffer(record+6);
 
-        /* total number of entries in the central dir on this disk */
-        if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&number_entry)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* total number of entries in the central dir on this disk */
+                number_entry = ziplocal_getShortFromBuffer(record+8);
 
-        /* total number of entries in the central dir */
-        if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&number_entry_CD)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* total number of entries in the central dir */
+                number_entry_CD = ziplocal_getShortFromBuffer(record+10);
 
-        if ((number_entry_CD!=number_entry) ||
-            (number_disk_with_CD!=0) ||
-            (number_disk!=0))
-            err=ZIP_BADZIPFILE;
+                /* size of the central directory */
+                size_central_dir = ziplocal_getLongFromBuffer(record+12);
 
-        /* size of the central directory */
-        if (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&size_central_dir)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* offset of start of central directory with respect to the
+                    starting disk number */
+                offset_central_dir = ziplocal_getLongFromBuffer(record+16);
 
-        /* offset of start of central directory with respect to the
-            starting disk number */
-        if (ziplocal_getLong(&ziinit.z_filefunc, ziinit.filestream,&offset_central_dir)!=ZIP_OK)
-            err=ZIP_ERRNO;
+                /* zipfile global comment length */
+                size_comment = ziplocal_getShortFromBuffer(record+20);
+            }
+        }
 
-        /* zipfile global comment length */
-        if (ziplocal_getShort(&ziinit.z_filefunc, ziinit.filestream,&size_comment)!=ZIP_OK)
-            err=ZIP_ERRNO;
+        /* a ZIP64 end of central directory record overrides the values above */
+        central_end = central_pos;
+        if (err==ZIP_OK)
+        {
+            ZPOS64_T zip64_pos = 0;
+            int err64 = ziplocal_ReadZip64CentralDir(&ziinit.z_filefunc,ziinit.filestream,
+                                                     central_pos,&zip64_pos,
+                                                     &number_entry,&number_entry_CD,
+                                                     &size_central_dir,&offset_central_dir);
+            if (err64==ZIP_OK)
+                central_end = zip64_pos;
+            else if (err64!=ZIP64_NOT_FOUND)
+                err=err64;
+
+            if ((number_entry_CD!=number_entry) ||
+                ((err64!=ZIP_OK) &&
+                 ((number_disk_with_CD!=0) || (number_disk!=0))))
+                err=ZIP_BADZIPFILE;
+        }
 
-        if ((central_pos<offset_central_dir+size_central_dir) &&
+        if ((central_end<offset_central_dir+size_central_dir) &&
             (err==ZIP_OK))
             err=ZIP_BADZIPFILE;
 
@@ -619,17 +692,21 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
             ziinit.globalcomment = ALLOC(size_comment+1);
             if (ziinit.globalcomment)
             {
-               size_comment = ZREAD(ziinit.z_filefunc, ziinit.filestream,ziinit.globalcomment,size_comment);
+               if (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
+                         central_pos+SIZECENTRALDIRRECORD,ZLIB_FILEFUNC_SEEK_SET)!=0)
+                   size_comment = 0;
+               else
+                   size_comment = ZREAD(ziinit.z_filefunc, ziinit.filestream,ziinit.globalcomment,size_comment);
                ziinit.globalcomment[size_comment]=0;
             }
         }
 
-        byte_before_the_zipfile = central_pos -
+        byte_before_the_zipfile = central_end -
                                 (offset_central_dir+size_central_dir);
         ziinit.add_position_when_writting_offset = byte_before_the_zipfile;
 
         {
-            uLong size_central_dir_to_read = size_central_dir;
+            ZPOS64_T size_central_dir_to_read = size_central_dir;
             size_t buf_size = SIZEDATA_INDATABLOCK;
             void* buf_read = (void*)ALLOC(buf_size);
             if (ZSEEK(ziinit.z_filefunc, ziinit.filestream,
@@ -641,7 +718,7 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
             {
                 uLong read_this = SIZEDATA_INDATABLOCK;
                 if (read_this > size_central_dir_to_read)
-                    read_this = size_central_dir_to_read;
+                    read_this = (uLong)size_central_dir_to_read;
                 if (ZREAD(ziinit.z_filefunc, ziinit.filestream,buf_read,read_this) != read_this)
                     err=ZIP_ERRNO;
 
@@ -681,6 +758,15 @@ extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc
     }
 }
 
+extern zipFile ZEXPORT zipOpen2 (pathname, append, globalcomment, pzlib_filefunc_def)
+    const char *pathname;
+    int append;
+    zipcharpc* globalcomment;
+    zlib_filefunc_def* pzlib_filefunc_def;
+{
+    return zipOpen3(pathname,append,globalcomment,pzlib_filefunc_def,0);
+}
+
 extern zipFile ZEXPORT zipOpen (pathname, append)
     const char *pathname;
     int append;
@@ -688,12 +774,12 @@ extern zipFile ZEXPORT zipOpen (pathname, append)
     return zipOpen2(pathname,append,NULL,NULL);
 }
 
-extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
-                                         extrafield_local, size_extrafield_local,
-                                         extrafield_global, size_extrafield_global,
-                                         comment, method, level, raw,
-                                         windowBits, memLevel, strategy,
-                                         password, crcForCrypting)
+extern int ZEXPORT zipOpenNewFileInZip3_64 (file, filename, zipfi,
+                                            extrafield_local, size_extrafield_local,
+                                            extrafield_global, size_extrafield_global,
+                                            comment, method, level, raw,
+                                            windowBits, memLevel, strategy,
+                                            password, crcForCrypting, zip64)
     zipFile file;
     const char* filename;
     const zip_fileinfo* zipfi;
@@ -710,6 +796,7 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     int strategy;
     const char* password;
     uLong crcForCrypting;
+    int zip64;
 {
     zip_internal* zi;
     uInt size_filename;
@@ -765,10 +852,16 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
       zi->ci.flag |= 6;
     if (password != NULL)
       zi->ci.flag |= 1;
+    if (zi->flags & ZIP_WRITE_DATA_DESCRIPTOR)
+      zi->ci.flag |= 8;
 
     zi->ci.crc32 = 0;
     zi->ci.method = method;
     zi->ci.encrypt = 0;
+    zi->ci.zip64 = zip64;
+    zi->ci.pos_zip64extrainfo = 0;
+    zi->ci.totalCompressedData = 0;
+    zi->ci.totalUncompressedData = 0;
     zi->ci.stream_initialised = 0;
     zi->ci.pos_in_buffered_data = 0;
     zi->ci.raw = raw;
@@ -802,7 +895,8 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     else
         ziplocal_putValue_inmemory(zi->ci.central_header+38,(uLong)zipfi->external_fa,4);
 
-    ziplocal_putValue_inmemory(zi->ci.central_header+42,(uLong)zi->ci.pos_local_header- zi->add_position_when_writting_offset,4);
+    /* saturated to 0xFFFFFFFF past 4 GB, the ZIP64 extra field is added on close */
+    ziplocal_putValue_inmemory(zi->ci.central_header+42,zi->ci.pos_local_header- zi->add_position_when_writting_offset,4);
 
     for (i=0;i<size_filename;i++)
         *(zi->ci.central_header+SIZECENTRALHEADER+i) = *(filename+i);
@@ -820,8 +914,8 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     /* write the local header */
     err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)LOCALHEADERMAGIC,4);
 
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)20,2);/* version needed to extract */
+    if (err==ZIP_OK) /* version needed to extract */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zi->ci.zip64 ? VERSIONNEEDEDZIP64 : 20),2);
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.flag,2);
 
@@ -833,16 +927,17 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
 
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* crc 32, unknown */
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* compressed size, unknown */
-    if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4); /* uncompressed size, unknown */
+    if (err==ZIP_OK) /* compressed size, unknown or in the ZIP64 extra field */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zi->ci.zip64 ? MAXUINT32 : 0),4);
+    if (err==ZIP_OK) /* uncompressed size, unknown or in the ZIP64 extra field */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(zi->ci.zip64 ? MAXUINT32 : 0),4);
 
     if (err==ZIP_OK)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_filename,2);
 
     if (err==ZIP_OK)
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_extrafield_local,2);
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                (uLong)(size_extrafield_local + (zi->ci.zip64 ? SIZEZIP64LOCALEXTRAFIELD : 0)),2);
 
     if ((err==ZIP_OK) && (size_filename>0))
         if (ZWRITE(zi->z_filefunc,zi->filestream,filename,size_filename)!=size_filename)
@@ -853,6 +948,19 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
                                                                            !=size_extrafield_local)
                 err = ZIP_ERRNO;
 
+    /* the sizes are filled in on close */
+    if ((err==ZIP_OK) && (zi->ci.zip64))
+    {
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64EXTRAFIELDID,2);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)(SIZEZIP64LOCALEXTRAFIELD-4),2);
+        zi->ci.pos_zip64extrainfo = ZTELL(zi->z_filefunc,zi->filestream);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(ZPOS64_T)0,8);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(ZPOS64_T)0,8);
+    }
+
     zi->ci.stream.avail_in = (uInt)0;
     zi->ci.stream.avail_out = (uInt)Z_BUFSIZE;
     zi->ci.stream.next_out = zi->ci.buffered_data;
@@ -884,6 +992,10 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
         zi->ci.pcrc_32_tab = get_crc_table();
         /*init_keys(password,zi->ci.keys,zi->ci.pcrc_32_tab);*/
 
+        /* the CRC is not known yet, the check byte is the high byte of the time */
+        if (zi->ci.flag & 8)
+            crcForCrypting = (uLong)zi->ci.dosDate << 16;
+
         sizeHead=crypthead(password,bufHead,RAND_HEAD_LEN,zi->ci.keys,zi->ci.pcrc_32_tab,crcForCrypting);
         zi->ci.crypt_header_size = sizeHead;
 
@@ -897,6 +1009,37 @@ extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
     return err;
 }
 
+extern int ZEXPORT zipOpenNewFileInZip3 (file, filename, zipfi,
+                                         extrafield_local, size_extrafield_local,
+                                         extrafield_global, size_extrafield_global,
+                                         comment, method, level, raw,
+                                         windowBits, memLevel, strategy,
+                                         password, crcForCrypting)
+    zipFile file;
+    const char* filename;
+    const zip_fileinfo* zipfi;
+    const void* extrafield_local;
+    uInt size_extrafield_local;
+    const void* extrafield_global;
+    uInt size_extrafield_global;
+    const char* comment;
+    int method;
+    int level;
+    int raw;
+    int windowBits;
+    int memLevel;
+    int strategy;
+    const char* password;
+    uLong crcForCrypting;
+{
+    return zipOpenNewFileInZip3_64 (file, filename, zipfi,
+                                    extrafield_local, size_extrafield_local,
+                                    extrafield_global, size_extrafield_global,
+                                    comment, method, level, raw,
+                                    windowBits, memLevel, strategy,
+                                    password, crcForCrypting, 0);
+}
+
 extern int ZEXPORT zipOpenNewFileInZip2(file, filename, zipfi,
                                         extrafield_local, size_extrafield_local,
                                         extrafield_global, size_extrafield_global,
@@ -960,6 +1103,7 @@ local int zipFlushWriteBuffer(zi)
     if (ZWRITE(zi->z_filefunc,zi->filestream,zi->ci.buffered_data,zi->ci.pos_in_buffered_data)
                                                                     !=zi->ci.pos_in_buffered_data)
       err = ZIP_ERRNO;
+    zi->ci.totalCompressedData += zi->ci.pos_in_buffered_data;
     zi->ci.pos_in_buffered_data = 0;
     return err;
 }
@@ -981,7 +1125,10 @@ extern int ZEXPORT zipWriteInFileInZip (file, buf, len)
 
     zi->ci.stream.next_in = (void*)buf;
     zi->ci.stream.avail_in = len;
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
+    /* raw data is written with the crc given to zipCloseFileInZipRaw */
+    if (!zi->ci.raw)
+        zi->ci.crc32 = crc32(zi->ci.crc32,buf,len);
+    zi->ci.totalUncompressedData += len;
 
     while ((err==ZIP_OK) && (zi->ci.stream.avail_in>0))
     {
@@ -1029,13 +1176,101 @@ extern int ZEXPORT zipWriteInFileInZip (file, buf, len)
     return err;
 }
 
+/*
+  Adds the ZIP64 extended information extra field to the central header of the
+    current file, with the values that do not fit the 4 bytes they have there.
+*/
+local int ziplocal_AddZip64CentralExtraField OF((zip_internal* zi,
+                                                 ZPOS64_T uncompressed_size,
+                                                 ZPOS64_T compressed_size,
+                                                 ZPOS64_T offset_local_header));
+
+local int ziplocal_AddZip64CentralExtraField (zi, uncompressed_size, compressed_size,
+                                              offset_local_header)
+    zip_internal* zi;
+    ZPOS64_T uncompressed_size;
+    ZPOS64_T compressed_size;
+    ZPOS64_T offset_local_header;
+{
+    char* central_header;
+    uLong size_data = 0;
+    uLong size_filename, size_extra, size_comment, pos;
+
+    if (uncompressed_size>=MAXUINT32)
+        size_data += 8;
+    if (compressed_size>=MAXUINT32)
+        size_data += 8;
+    if (offset_local_header>=MAXUINT32)
+        size_data += 8;
+    if (size_data==0)
+        return ZIP_OK;
+
+    size_filename = zi->ci.central_header[28] & 0xff;
+    size_filename |= (zi->ci.central_header[29] & 0xff) << 8;
+    size_extra = zi->ci.central_header[30] & 0xff;
+    size_extra |= (zi->ci.central_header[31] & 0xff) << 8;
+    size_comment = zi->ci.size_centralheader - SIZECENTRALHEADER - size_filename - size_extra;
+    if (size_extra+4+size_data>0xffff)
+        return ZIP_PARAMERROR;
+
+    central_header = (char*)ALLOC(zi->ci.size_centralheader+4+size_data);
+    if (central_header==NULL)
+        return ZIP_INTERNALERROR;
+
+    /* fixed part, name and current extra field stay, the ZIP64 one goes after them */
+    pos = SIZECENTRALHEADER+size_filename+size_extra;
+    memcpy(central_header,zi->ci.central_header,pos);
+    ziplocal_putValue_inmemory(central_header+pos,(uLong)ZIP64EXTRAFIELDID,2);
+    ziplocal_putValue_inmemory(central_header+pos+2,size_data,2);
+    pos += 4;
+    if (uncompressed_size>=MAXUINT32)
+    {
+        ziplocal_putValue_inmemory(central_header+pos,uncompressed_size,8);
+        pos += 8;
+    }
+    if (compressed_size>=MAXUINT32)
+    {
+        ziplocal_putValue_inmemory(central_header+pos,compressed_size,8);
+        pos += 8;
+    }
+    if (offset_local_header>=MAXUINT32)
+    {
+        ziplocal_putValue_inmemory(central_header+pos,offset_local_header,8);
+        pos += 8;
+    }
+    memcpy(central_header+pos,zi->ci.central_header+SIZECENTRALHEADER+size_filename+size_extra,
+           size_comment);
+
+    ziplocal_putValue_inmemory(central_header+6,(uLong)VERSIONNEEDEDZIP64,2);
+    ziplocal_putValue_inmemory(central_header+30,size_extra+4+size_data,2);
+    if (uncompressed_size>=MAXUINT32)
+        ziplocal_putValue_inmemory(central_header+24,(uLong)MAXUINT32,4);
+    if (compressed_size>=MAXUINT32)
+        ziplocal_putValue_inmemory(central_header+20,(uLong)MAXUINT32,4);
+    if (offset_local_header>=MAXUINT32)
+        ziplocal_putValue_inmemory(central_header+42,(uLong)MAXUINT32,4);
+
+    free(zi->ci.central_header);
+    zi->ci.central_header = central_header;
+    zi->ci.size_centralheader += 4+size_data;
+    return ZIP_OK;
+}
+
 extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
     zipFile file;
     uLong uncompressed_size;
     uLong crc32;
+{
+    return zipCloseFileInZipRaw64 (file, (ZPOS64_T)uncompressed_size, crc32);
+}
+
+extern int ZEXPORT zipCloseFileInZipRaw64 (file, uncompressed_size, crc32)
+    zipFile file;
+    ZPOS64_T uncompressed_size;
+    uLong crc32;
 {
     zip_internal* zi;
-    uLong compressed_size;
+    ZPOS64_T compressed_size;
     int err=ZIP_OK;
 
     if (file == NULL)
@@ -1078,9 +1313,9 @@ extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
     if (!zi->ci.raw)
     {
         crc32 = (uLong)zi->ci.crc32;
-        uncompressed_size = (uLong)zi->ci.stream.total_in;
+        uncompressed_size = zi->ci.totalUncompressedData;
     }
-    compressed_size = (uLong)zi->ci.stream.total_out;
+    compressed_size = zi->ci.totalCompressedData;
 #    ifndef NOCRYPT
     compressed_size += zi->ci.crypt_header_size;
 #    endif
@@ -1093,14 +1328,31 @@ extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
     ziplocal_putValue_inmemory(zi->ci.central_header+24,
                                 uncompressed_size,4); /*uncompr size*/
 
+    if (err==ZIP_OK)
+        err = ziplocal_AddZip64CentralExtraField(zi,uncompressed_size,compressed_size,
+                  zi->ci.pos_local_header - zi->add_position_when_writting_offset);
+
     if (err==ZIP_OK)
         err = add_data_in_datablock(&zi->central_dir,zi->ci.central_header,
                                        (uLong)zi->ci.size_centralheader);
     free(zi->ci.central_header);
 
-    if (err==ZIP_OK)
+    if ((err==ZIP_OK) && (zi->ci.flag & 8))
     {
-        long cur_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
+        /* the local header keeps zeros, the values follow the data */
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)DATADESCRIPTORMAGIC,4);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,crc32,4);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,
+                                    zi->ci.zip64 ? 8 : 4);
+        if (err==ZIP_OK)
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,
+                                    zi->ci.zip64 ? 8 : 4);
+    }
+    else if (err==ZIP_OK)
+    {
+        ZPOS64_T cur_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
         if (ZSEEK(zi->z_filefunc,zi->filestream,
                   zi->ci.pos_local_header + 14,ZLIB_FILEFUNC_SEEK_SET)!=0)
             err = ZIP_ERRNO;
@@ -1108,11 +1360,26 @@ extern int ZEXPORT zipCloseFileInZipRaw (file, uncompressed_size, crc32)
         if (err==ZIP_OK)
             err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,crc32,4); /* crc 32, unknown */
 
+        /* without a ZIP64 extra field sizes past 4 GB are saturated, the
+           central directory has the actual ones */
         if (err==ZIP_OK) /* compressed size, unknown */
-            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,4);
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    zi->ci.zip64 ? (ZPOS64_T)MAXUINT32 : compressed_size,4);
 
         if (err==ZIP_OK) /* uncompressed size, unknown */
-            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,4);
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    zi->ci.zip64 ? (ZPOS64_T)MAXUINT32 : uncompressed_size,4);
+
+        if ((err==ZIP_OK) && (zi->ci.zip64))
+        {
+            if (ZSEEK(zi->z_filefunc,zi->filestream,
+                      zi->ci.pos_zip64extrainfo,ZLIB_FILEFUNC_SEEK_SET)!=0)
+                err = ZIP_ERRNO;
+            if (err==ZIP_OK)
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,8);
+            if (err==ZIP_OK)
+                err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,compressed_size,8);
+        }
 
         if (ZSEEK(zi->z_filefunc,zi->filestream,
                   cur_pos_inzip,ZLIB_FILEFUNC_SEEK_SET)!=0)
@@ -1137,8 +1404,8 @@ extern int ZEXPORT zipClose (file, global_comment)
 {
     zip_internal* zi;
     int err = 0;
-    uLong size_centraldir = 0;
-    uLong centraldir_pos_inzip;
+    ZPOS64_T size_centraldir = 0;
+    ZPOS64_T centraldir_pos_inzip;
     uInt size_global_comment;
     if (file == NULL)
         return ZIP_PARAMERROR;
@@ -1176,6 +1443,49 @@ extern int ZEXPORT zipClose (file, global_comment)
     }
     free_datablock(zi->central_dir.first_block);
 
+    /* the ZIP64 end of central directory record and its locator go first
+       when a value does not fit the end of central directory record */
+    if ((err==ZIP_OK) &&
+        ((zi->number_entry>=0xffff) ||
+         (size_centraldir>=MAXUINT32) ||
+         (centraldir_pos_inzip - zi->add_position_when_writting_offset>=MAXUINT32)))
+    {
+        ZPOS64_T zip64_pos_inzip = ZTELL(zi->z_filefunc,zi->filestream);
+
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDHEADERMAGIC,4);
+        if (err==ZIP_OK) /* size of the remaining record */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    (ZPOS64_T)(SIZEZIP64CENTRALDIRRECORD-12),8);
+        if (err==ZIP_OK) /* version made by */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)VERSIONMADEBY,2);
+        if (err==ZIP_OK) /* version needed */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)VERSIONNEEDEDZIP64,2);
+        if (err==ZIP_OK) /* number of this disk */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+        if (err==ZIP_OK) /* number of the disk with the start of the central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+        if (err==ZIP_OK) /* total number of entries in the central dir on this disk */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,zi->number_entry,8);
+        if (err==ZIP_OK) /* total number of entries in the central dir */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,zi->number_entry,8);
+        if (err==ZIP_OK) /* size of the central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,size_centraldir,8);
+        if (err==ZIP_OK) /* offset of start of central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    centraldir_pos_inzip - zi->add_position_when_writting_offset,8);
+
+        if (err==ZIP_OK) /* locator */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ZIP64ENDLOCHEADERMAGIC,4);
+        if (err==ZIP_OK) /* number of the disk with the ZIP64 end of central directory */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,4);
+        if (err==ZIP_OK) /* offset of the ZIP64 end of central directory record */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
+                                    zip64_pos_inzip - zi->add_position_when_writting_offset,8);
+        if (err==ZIP_OK) /* total number of disks */
+            err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)1,4);
+    }
+
+    /* values that do not fit are saturated by ziplocal_putValue */
     if (err==ZIP_OK) /* Magic End */
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)ENDHEADERMAGIC,4);
 
@@ -1186,18 +1496,18 @@ extern int ZEXPORT zipClose (file, global_comment)
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)0,2);
 
     if (err==ZIP_OK) /* total number of entries in the central dir on this disk */
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,2);
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,zi->number_entry,2);
 
     if (err==ZIP_OK) /* total number of entries in the central dir */
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->number_entry,2);
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,zi->number_entry,2);
 
     if (err==ZIP_OK) /* size of the central directory */
-        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_centraldir,4);
+        err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,size_centraldir,4);
 
     if (err==ZIP_OK) /* offset of start of central directory with respect to the
                             starting disk number */
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,
-                                (uLong)(centraldir_pos_inzip - zi->add_position_when_writting_offset),4);
+                                centraldir_pos_inzip - zi->add_position_when_writting_offset,4);
 
     if (err==ZIP_OK) /* zipfile comment length */
         err = ziplocal_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_global_comment,2);
@@ -136,6 +136,22 @@ extern zipFile ZEXPORT zipOpen2 OF((const char *pathname,
                                    zipcharpc* globalcomment,
                                    zlib_filefunc_def* pzlib_filefunc_def));
 
+#define ZIP_WRITE_DATA_DESCRIPTOR   (0x8u)
+
+extern zipFile ZEXPORT zipOpen3 OF((const char *pathname,
+                                   int append,
+                                   zipcharpc* globalcomment,
+                                   zlib_filefunc_def* pzlib_filefunc_def,
+                                   unsigned flags));
+/*
+  Same as zipOpen2, flags can be 0 or ZIP_WRITE_DATA_DESCRIPTOR.
+  With ZIP_WRITE_DATA_DESCRIPTOR the CRC and the sizes of each file are written
+    after its data in a data descriptor (general purpose bit 3) instead of going
+    back to the local header. The zipfile is then written strictly sequentially
+    and can be a pipe or a socket, as long as the tell function of
+    pzlib_filefunc_def returns the number of bytes written so far.
+*/
+
 extern int ZEXPORT zipOpenNewFileInZip OF((zipFile file,
                        const char* filename,
                        const zip_fileinfo* zipfi,
@@ -200,6 +216,32 @@ extern int ZEXPORT zipOpenNewFileInZip3 OF((zipFile file,
     crcForCtypting : crc of file to compress (needed for crypting)
  */
 
+extern int ZEXPORT zipOpenNewFileInZip3_64 OF((zipFile file,
+                                               const char* filename,
+                                               const zip_fileinfo* zipfi,
+                                               const void* extrafield_local,
+                                               uInt size_extrafield_local,
+                                               const void* extrafield_global,
+                                               uInt size_extrafield_global,
+                                               const char* comment,
+                                               int method,
+                                               int level,
+                                               int raw,
+                                               int windowBits,
+                                               int memLevel,
+                                               int strategy,
+                                               const char* password,
+                                               uLong crcForCtypting,
+                                               int zip64));
+
+/*
+  Same than zipOpenNewFileInZip3, except
+    zip64 : 1 if the file may be 4 GB or more. The local header then gets a
+      ZIP64 extra field, the only place its sizes can be written back to.
+      The central directory and the end of the zipfile get their ZIP64
+      records whenever they are needed, whatever this parameter is.
+ */
+
 
 extern int ZEXPORT zipWriteInFileInZip OF((zipFile file,
                        const void* buf,
@@ -222,6 +264,13 @@ extern int ZEXPORT zipCloseFileInZipRaw OF((zipFile file,
   uncompressed_size and crc32 are value for the uncompressed size
 */
 
+extern int ZEXPORT zipCloseFileInZipRaw64 OF((zipFile file,
+                                              ZPOS64_T uncompressed_size,
+                                              uLong crc32));
+/*
+  Same than zipCloseFileInZipRaw, for files of 4 GB or more
+*/
+
 extern int ZEXPORT zipClose OF((zipFile file,
                 const char* global_comment));
 /*
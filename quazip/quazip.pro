@@ -36,7 +36,9 @@ INCLUDEPATH += . \
 HEADERS += "$$PWD/../zlib/1.2.3/include/zlib.h" \
            $$QUAZIP_SRC_PATH/crypt.h \   
            $$QUAZIP_SRC_PATH/ioapi.h \
+           $$QUAZIP_SRC_PATH/qioapi.h \
            $$QUAZIP_SRC_PATH/quazip.h \
+           $$QUAZIP_SRC_PATH/quazipdirentry.h \
            $$QUAZIP_SRC_PATH/quazipfile.h \
            $$QUAZIP_SRC_PATH/quazipfileinfo.h \
            $$QUAZIP_SRC_PATH/quazipnewinfo.h \
@@ -46,6 +48,7 @@ HEADERS += "$$PWD/../zlib/1.2.3/include/zlib.h" \
 # Input 
 
 SOURCES += $$QUAZIP_SRC_PATH/ioapi.c \
+           $$QUAZIP_SRC_PATH/qioapi.cpp \
            $$QUAZIP_SRC_PATH/quazip.cpp \
            $$QUAZIP_SRC_PATH/quazipfile.cpp \
            $$QUAZIP_SRC_PATH/quazipnewinfo.cpp\
@@ -323,6 +323,251 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     return;
 }
 
+#ifdef INFLATE_FAST64
+
+#ifdef _MSC_VER
+typedef unsigned __int64 hold64;
+#else
+typedef unsigned long long hold64;
+#endif
+
+/* unaligned little-endian load of eight input bytes */
+local hold64 load64(p)
+const unsigned char FAR *p;
+{
+    hold64 val;
+
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+/*
+   Same decoding as inflate_fast(), with these differences:
+
+    - hold is 64 bits wide and is topped up to at least 56 bits once at the
+      start of each iteration by loading eight bytes and advancing in by the
+      number of whole bytes that fit.  56 bits covers the 48 bits a
+      length/distance pair can use, so no other refills are needed.  Bits of
+      hold above bits may hold copies of the next input byte; they are ORed
+      with the same values on the next refill and masked off on return.
+
+    - Matches that lie entirely in the output with a distance of at least
+      eight are copied eight bytes at a time, overwriting up to seven bytes
+      past the end of the match.  Those bytes lie in the unwritten part of
+      the caller's output buffer and are replaced by later output.
+
+    - Window copies are done with memcpy(), since inflate() never has the
+      window and the output buffer overlap.
+
+   Entry assumptions are those of inflate_fast(), except that
+   strm->avail_in >= INFLATE_FAST64_MIN_IN and
+   strm->avail_out >= INFLATE_FAST64_MIN_OUT.
+ */
+void ZLIB_INTERNAL inflate_fast64(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *in;      /* local strm->next_in */
+    unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *inend;   /* end of the input buffer */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *outend;  /* end of the output buffer */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    hold64 hold;                /* local strm->hold, widened */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code here;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+    unsigned char FAR *stop;    /* end of the match being copied */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    inend = in + strm->avail_in;
+    last = inend - 8;
+    out = strm->next_out;
+    outend = out + strm->avail_out;
+    beg = out - (start - strm->avail_out);
+    end = outend - 265;
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        hold |= load64(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+        here = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(here.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here.val));
+            *out++ = (unsigned char)(here.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            here = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(here.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here.val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        if (state->sane) {
+                            strm->msg =
+                                (char *)"invalid distance too far back";
+                            state->mode = BAD;
+                            break;
+                        }
+                    }
+                    from = window;
+                    if (wnext == 0) {           /* very common case */
+                        from += wsize - op;
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            memcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = wnext;
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += wnext - op;
+                    }
+                    if (op < len) {             /* some from window */
+                        len -= op;
+                        memcpy(out, from, op);
+                        out += op;
+                        from = out - dist;      /* rest from output */
+                    }
+                    else {                      /* all from window */
+                        memcpy(out, from, len);
+                        out += len;
+                        continue;
+                    }
+                }
+                else
+                    from = out - dist;          /* copy direct from output */
+                stop = out + len;
+                if (dist >= 8) {
+                    do {
+                        memcpy(out, from, 8);
+                        out += 8;
+                        from += 8;
+                    } while (out < stop);
+                    out = stop;
+                }
+                else {
+                    do {
+                        *out++ = *from++;
+                    } while (out < stop);
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode[here.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode[here.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes, leaving less than one byte in hold */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= ((hold64)1 << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(inend - in);
+    strm->avail_out = (unsigned)(outend - out);
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#endif /* INFLATE_FAST64 */
+
 /*
    inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
    - Using bit fields for code structure
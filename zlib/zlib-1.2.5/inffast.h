@@ -9,3 +9,31 @@
  */
 
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
+
+/* inflate_fast64() is a variant of inflate_fast() for 64-bit little-endian
+   targets.  It keeps a 64-bit bit accumulator that is refilled once per
+   length/distance pair with a single unaligned load and copies matches eight
+   bytes at a time.  To do that it needs more slack than inflate_fast(): it
+   reads up to seven bytes past the last input byte it consumes and writes up
+   to seven bytes past the end of a match, hence the larger minimum buffer
+   sizes below.  It is only called by inflate(), never by inflateBack(), since
+   the latter uses the window itself as the output buffer.  Define
+   NO_INFLATE_FAST64 to disable it, or INFLATE_FAST64 to force it on for
+   another little-endian target with cheap unaligned loads.
+   Only programs built against this zlib get it: quazip, the CFF adaptor and
+   the benchmark use the zlib/1.2.3 headers and link an external zlib, so the
+   ubz unpacking doesn't go through this code until they are moved to it. */
+#if !defined(INFLATE_FAST64) && !defined(NO_INFLATE_FAST64) && \
+    !defined(ASMINF) && !defined(INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR)
+#  if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64) || \
+      (defined(__aarch64__) && defined(__BYTE_ORDER__) && \
+       __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#    define INFLATE_FAST64
+#  endif
+#endif
+
+#ifdef INFLATE_FAST64
+#  define INFLATE_FAST64_MIN_IN 16
+#  define INFLATE_FAST64_MIN_OUT 266
+void ZLIB_INTERNAL inflate_fast64 OF((z_streamp strm, unsigned start));
+#endif
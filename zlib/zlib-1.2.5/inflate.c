@@ -1004,6 +1004,17 @@ int flush;
         case LEN_:
             state->mode = LEN;
         case LEN:
+#ifdef INFLATE_FAST64
+            if (have >= INFLATE_FAST64_MIN_IN &&
+                left >= INFLATE_FAST64_MIN_OUT) {
+                RESTORE();
+                inflate_fast64(strm, out);
+                LOAD();
+                if (state->mode == TYPE)
+                    state->back = -1;
+                break;
+            }
+#endif
             if (have >= 6 && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);